@@ -0,0 +1,40 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "compat.h"
+
+/* Scratch memory for one job: page-aligned blocks carved by a bump pointer
+   into 64-byte aligned pieces. Nothing is freed piecewise; arena_reset()
+   drops every allocation but keeps the pages, so the next job on the same
+   worker reuses memory that is already mapped and touched. A job that
+   outgrows the block spills into extra blocks, which the next reset folds
+   into one block of the combined size.
+
+   Every function taking an Arena* also accepts NULL and then falls back to
+   the heap, so stages can still be used on their own. */
+#define ARENA_ALIGN 64
+
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct {
+    uint8_t    *base;
+    size_t      cap, used;
+    ArenaBlock *spill;
+    size_t      spilled;       /* bytes handed out from spill blocks */
+    size_t      peak;
+} Arena;
+
+int    arena_init(Arena *a, size_t cap);
+void   arena_reset(Arena *a);
+void   arena_destroy(Arena *a);
+
+void*  arena_alloc(Arena *a, size_t bytes);
+void*  arena_calloc(Arena *a, size_t n, size_t size);
+/* heap fallback only; a no-op for arena memory */
+void   arena_free(Arena *a, void *p);
+
+/* n buffers of `len` floats each; returns the pointer array */
+float** arena_planes(Arena *a, uint16_t n, uint32_t len);
+void    arena_free_planes(Arena *a, float **x, uint16_t n);
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "render.h"
+
+/* Files at least this long are rendered one task per channel group
+   (render_split_width()) in memory mode, so a few long recordings cannot
+   keep one worker busy after the rest are done; shorter ones keep the
+   channels side by side in one chain. */
+#define BATCH_SPLIT_FRAMES (1u << 19)
+
+typedef struct {
+    const char *source;     /* directory of .wav files, or a manifest: one path per line */
+    const char *output;     /* path template with {name} and {preset} */
+    const int  *presets;
+    int         npresets;
+    int         threads;
+} BatchOptions;
+
+/* Renders every selected preset of every file on a work-stealing
+   scheduler, longest files first, and prints a throughput summary.
+   Returns 1 when every output was written. */
+int batch_run(const BatchOptions *bo, const PresetBook *book, const RenderOptions *opt);
+
+#endif
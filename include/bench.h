@@ -14,6 +14,17 @@ typedef struct {
 } BenchSnapshot;
 
 void bench_snapshot(BenchSnapshot *out);
+/* "---- title ----" centered in 54 columns on stderr; header-only so the
+   PROFILE=1 report shares it in builds without BENCH */
+static inline void bench_banner(const char *title) {
+    const char *dashes = "------------------------------------------------------------";
+    int len = (int)strlen(title);
+    int w = 54;
+    int left = (w - len - 2); if (left < 0) left = 0;
+    int l = left/2, r = left - l;
+    fprintf(stderr, "%.*s %s %.*s\n", l, dashes, title, r, dashes);
+}
+
 void bench_report_diff(const BenchSnapshot *before,
                        const BenchSnapshot *after,
                        const char *label);
\ No newline at end of file
@@ -0,0 +1,147 @@
+#ifndef CHAIN_H
+#define CHAIN_H
+
+#include "compat.h"
+#include "dsp.h"
+#include "biquad_multi.h"
+#include "stream.h"
+#include "resample.h"
+#include "pitch.h"
+#include "reverb.h"
+#include "arena.h"
+#include "prof.h"
+
+/* A preset as a list of stages. Every stage keeps its own per-channel state,
+   so the chain can run over the whole buffer at once or block by block.
+   Stages that need a statistic of the whole signal (peak/RMS normalize,
+   SNR-relative noise) are resolved by an analysis pass in streaming mode.
+   When a source is bound the list is compiled into a plan: runs of
+   pointwise stages (gain, normalize gain, tanh, bitcrush, clip, ring mod,
+   tremolo, noise) become one fused_process() call. A whole-signal stage
+   may only lead such a run, so analysis boundaries stay intact. */
+typedef enum {
+    ST_RESAMPLE,    /* head only, a = ratio, b = ResampleQuality; output fitted
+                       back to the source length */
+    ST_PITCH,       /* head only, a = ratio; duration kept, latency compensated */
+    ST_SOS,         /* consecutive biquads merged into one cascade */
+    ST_GAIN,
+    ST_PEAK_NORM,
+    ST_RMS_NORM,
+    ST_TANH,
+    ST_RING_MOD,
+    ST_TREMOLO,
+    ST_BITCRUSH,
+    ST_NOISE,
+    ST_CLIP,
+    ST_REVERB
+} StageKind;
+
+/* A normalize whose output reaches another normalize through linear
+   stages only (biquads, gain, reverb, ring mod, tremolo) is folded away:
+   the later one rescales anyway, so it is neither measured nor applied.
+   One that reaches the end of the chain that way is measured but its gain
+   is applied last, after the linear stages, or handed to the caller. */
+enum { DEFER_NONE, DEFER_FOLD, DEFER_TAIL };
+
+typedef struct {
+    Sos      sos;
+    Osc      lfo;
+    float    gain;      /* resolved normalize gain, or noise std */
+    float    peak;
+    double   acc;
+    Rng      rng;
+    Reverb   rv;
+} StageState;
+
+typedef struct {
+    StageKind     kind;
+    float         a, b;
+    int           fuse_end;   /* leader of a fused run: one past its last stage */
+    int           defer;      /* normalize gains: DEFER_* */
+    Sos           coef;
+    PolyResampler rs;
+    PitchSource   ps;
+    BiquadBlock4 *b4;         /* FILTER_BLOCK4 cascade coefficients, or NULL */
+    StageState   *ch;
+#if PROFILE
+    const char   *prof_name, *prof_an_name;
+    ProfStat     *prof, *prof_an;   /* per channel, then PROF_ALL_CH */
+#endif
+} Stage;
+
+typedef struct {
+    Stage     *st;
+    int        nst, cap;
+    int        nhead;
+    uint16_t   nch;
+    float      sr;
+    uint32_t   block;
+    FxSource  *src, *head;
+    uint32_t   n, pos;
+    float    **scratch;
+    uint32_t   seed;
+    uint16_t   ch0;
+    int        tail;      /* stage with DEFER_TAIL, or -1 */
+    MemSource  feed;      /* live mode: the block being pushed */
+    uint64_t   live_n;
+    const char *name;     /* preset name, for profiles */
+#if PROFILE
+    const char *prof_name, *prof_head_name, *prof_tail_name;
+    ProfStat   *prof_head, *prof_tail;
+#endif
+    Arena     *mem;
+} FxChain;
+
+/* Stage state and every buffer the chain needs come from `mem` (or the
+   heap when it is NULL); the arena must outlive the chain. */
+int  chain_init(FxChain *c, float sr, uint16_t nch, Arena *mem);
+void chain_free(FxChain *c);
+
+/* Noise stages draw from per-stage, per-channel generators derived from
+   (seed, first_channel + ch, stage index), so a chain rendering a single
+   channel of a file reproduces that channel of a multi-channel chain. */
+void chain_set_seed(FxChain *c, uint32_t seed, uint16_t first_channel);
+
+void chain_set_name(FxChain *c, const char *name);
+
+/* switches every limiter stage between libm tanhf and tanh_fast() */
+void chain_set_tanh_mode(FxChain *c, TanhMode mode);
+
+/* FILTER_BLOCK4 runs the cascades of a mono chain through
+   sos_process_block4(); chains of several channels keep the lanes, which
+   are exact and faster. Call it after the stages are added. */
+int  chain_set_filter_mode(FxChain *c, FilterMode mode);
+
+int  chain_add(FxChain *c, StageKind kind, float a, float b);
+int  chain_add_biquad(FxChain *c, Biquad q);
+int  chain_add_bandlimit(FxChain *c, float f_lo, float f_hi);
+int  chain_add_bandpass_boost(FxChain *c, float f_center, float q, float gain_db);
+int  chain_add_reverb(FxChain *c, const ReverbParams *p);
+
+/* algorithmic latency of the head stages in frames; renders through
+   chain_process_buffer()/chain_pull() already compensate it */
+uint32_t chain_latency(const FxChain *c);
+
+/* whole-signal mode: x[ch][n] processed in place, all channels per tile.
+   Whole-signal statistics are gathered while the tiles pass through the
+   stages before them, not in a separate read. */
+int      chain_process_buffer(FxChain *c, float **x, uint32_t n);
+/* same, but a deferred tail gain is returned in gain[ch] instead of
+   applied, so the writer can fold it into quantization */
+int      chain_process_buffer_gain(FxChain *c, float **x, uint32_t n, float *gain);
+
+/* streaming mode: bind a source and run the analysis passes, then pull
+   output blocks of at most `block` frames until chain_pull() returns 0 */
+int      chain_prepare(FxChain *c, FxSource *src, uint32_t block);
+uint32_t chain_pull(FxChain *c, float **out, uint32_t count);
+
+/* live mode: blocks of at most `block` frames are pushed through in place
+   as they arrive. There are no analysis passes: normalize and noise
+   stages use their statistic over the signal so far, this block
+   included. Head latency is not compensated, so the output lags the
+   input by chain_latency(). Chains with a resample stage (which changes
+   the duration) cannot run live. */
+int      chain_start_live(FxChain *c, uint32_t block);
+uint32_t chain_process_live(FxChain *c, float **x, uint32_t n);
+
+#endif
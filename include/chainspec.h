@@ -0,0 +1,51 @@
+#ifndef CHAINSPEC_H
+#define CHAINSPEC_H
+
+#include "compat.h"
+#include "chain.h"
+
+/* A chain as text, one stage per line; `#` starts a comment. Arguments
+   are numbers, frequencies in Hz, levels in dB:
+
+     resample <ratio> [quality 0-2]     pitch <semitones>
+     decimate <hz>                      gain <db>
+     highpass <hz> [q]                  lowpass <hz> [q]
+     peak <hz> <q> <gain_db>            bandlimit <lo_hz> <hi_hz>
+     bandpass_boost <hz> <q> <gain_db>  peak_norm <db>
+     rms_norm <db>                      tanh <drive_db>
+     ring_mod <hz> [depth]              tremolo <hz> <depth>
+     bitcrush <bits>                    noise <snr_db>
+     clip
+     reverb <rt60> <damping> <wet> <fdn1> <fdn2> <fdn3> <fdn4> [<tap_sec> <tap_gain>]...
+
+   `decimate` resamples down to <hz> and back; a rate of 0.8 of the input
+   rate or more is replaced by 0.6 of Nyquist (at least 1 kHz). Reverb
+   delays are seconds in (0, REVERB_MAX_SEC], or all four FDN times 0 for
+   early reflections only; rt60 > 0, damping in [0,1), wet in [0,1].
+   `pitch` takes at most PITCH_MAX_SEMITONES either way. Parsing
+   does not depend on the sample rate, so a spec is checked once and built
+   for any rate later. */
+#define PITCH_MAX_SEMITONES 24.0f   /* the shifter's ratio range, 0.25..4 */
+#define CHAIN_SPEC_STAGES 32
+#define CHAIN_SPEC_ARGS   23
+
+typedef struct {
+    int   op;
+    int   nargs;
+    float arg[CHAIN_SPEC_ARGS];
+} SpecStage;
+
+typedef struct {
+    int       n;
+    SpecStage st[CHAIN_SPEC_STAGES];
+} ChainSpec;
+
+void chainspec_init(ChainSpec *s);
+/* one line; blank and comment-only lines are accepted and add nothing */
+int  chainspec_parse_line(ChainSpec *s, const char *line);
+/* whole text; on failure *bad_line is the 1-based line that failed */
+int  chainspec_parse(ChainSpec *s, const char *text, int *bad_line);
+/* appends the stages to an initialized chain, designed for its rate */
+int  chainspec_build(const ChainSpec *s, FxChain *c);
+
+#endif
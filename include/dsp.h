@@ -2,6 +2,9 @@
 #define DSP_H
 
 #include "compat.h"
+#include "osc.h"
+#include "rng.h"
+#include "pitch.h"
 
 typedef struct {
     float b0,b1,b2,a1,a2;
@@ -13,24 +16,96 @@ Biquad biquad_highpass(float sr, float fc, float q);
 Biquad biquad_peak(float sr, float fc, float q, float gain_db);
 void   biquad_process_inplace(float *x, uint32_t n, Biquad *q);
 
+/* Feedback state below this is flushed to zero, biquad z1/z2 every
+   SOS_BLOCK samples and the reverb loop filters every sample, so tails
+   decaying through silence never reach the subnormal range, which x86
+   runs tens of times slower. -300 dBFS is far below the resolution of
+   any output format. */
+#define DENORMAL_FLOOR 1e-15f
+
+static inline float flush_denormal(float v){
+    return fabsf(v) < DENORMAL_FLOOR ? 0.0f : v;
+}
+
+/* Cascade of second-order sections applied per cache-sized block, so the
+   signal is streamed through memory once instead of once per filter. */
+#define SOS_MAX_STAGES 8
+#define SOS_BLOCK      256
+
+typedef struct {
+    int    nstages;
+    Biquad st[SOS_MAX_STAGES];
+} Sos;
+
+void sos_init(Sos *s);
+int  sos_add(Sos *s, Biquad q);
+void sos_reset(Sos *s);
+void sos_process(Sos *s, float *x, uint32_t n);
+int  sos_bandlimit(Sos *s, float sr, float f_lo, float f_hi);
+int  sos_bandpass_boost(Sos *s, float sr, float f_center, float q, float gain_db);
+
 float db_to_lin(float db);
-float randf_uniform(void);
-float randf_normal(void);
+uint32_t seed_mix(uint32_t a, uint32_t b);
+
+float  peak_abs(const float *x, uint32_t n, float peak);
+double sum_squares(const float *x, uint32_t n, double acc);
+void   apply_gain(float *x, uint32_t n, float g);
 
 void peak_normalize(float *x, uint32_t n, float target_db);
 void rms_normalize(float *x, uint32_t n, float target_db);
 void soft_limiter_tanh(float *x, uint32_t n, float drive_db);
+
+/* Rational (odd 13/6) tanh approximation, evaluated four lanes at a time.
+   max |tanh_fast(x) - tanh(x)| < 4e-7 over all finite x (libm tanhf: 1e-7),
+   so the limiter output moves by < 5e-7 for drives >= 1 dB, far below one
+   16-bit LSB (3.05e-5). Vector and scalar tails give identical results. */
+typedef enum { TANH_EXACT, TANH_FAST } TanhMode;
+
+float tanh_fast(float x);
+void  soft_limiter_tanh_fast(float *x, uint32_t n, float drive_db);
 void ring_mod(float *x, uint32_t n, float sr, float f_hz, float depth);
 void tremolo(float *x, uint32_t n, float sr, float rate_hz, float depth);
 void bitcrush(float *x, uint32_t n, int bits);
-void add_white_noise_snr(float *x, uint32_t n, float snr_db);
+void add_white_noise_snr(float *x, uint32_t n, float snr_db, Rng *rng);
 void clip_safe(float *x, uint32_t n);
 
+/* block variants carrying oscillator phase / rng state across calls */
+void ring_mod_block(float *x, uint32_t n, Osc *lfo, float depth);
+void tremolo_block(float *x, uint32_t n, Osc *lfo, float depth);
+void add_white_noise_std(float *x, uint32_t n, float std, Rng *rng);
+
+/* Consecutive pointwise ops fused at block level: the buffer is cut into
+   256-sample blocks and each op runs over a block in turn, so the
+   block stays in L1 between ops instead of the whole buffer going through
+   memory once per op. Same results, bit for bit, as running each op's own
+   function over the buffer in turn. */
+#define FUSED_MAX_OPS 8
+
+typedef enum {
+    FOP_GAIN,         /* a = factor */
+    FOP_TANH,         /* a = drive dB */
+    FOP_TANH_FAST,
+    FOP_BITCRUSH,     /* a = bits */
+    FOP_CLIP,
+    FOP_RING_MOD,     /* a = depth, lfo */
+    FOP_TREMOLO,
+    FOP_NOISE         /* a = std, rng; clips like add_white_noise_std() */
+} FusedOpKind;
+
+typedef struct {
+    FusedOpKind kind;
+    float       a;
+    Osc        *lfo;
+    Rng        *rng;
+} FusedOp;
+
+void fused_process(const FusedOp *ops, int nops, float *x, uint32_t n);
+
 void bandlimit(float *x, uint32_t n, float sr, float f_lo, float f_hi);
 void bandpass_boost(float *x, uint32_t n, float sr, float f_center, float q, float gain_db);
 
 float*   resample_linear(const float *x, uint32_t n, float ratio, uint32_t *out_n);
 uint32_t pitch_shift_change_duration(float **px, uint32_t n, float semitones);
-void     pitch_shift_simple(float *x, uint32_t n, float semitones);
+void     pitch_shift_simple(float *x, uint32_t n, float sr, float semitones);   /* keeps duration */
 
 #endif
\ No newline at end of file
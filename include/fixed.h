@@ -0,0 +1,81 @@
+#ifndef FIXED_H
+#define FIXED_H
+
+#include "compat.h"
+#include "chain.h"
+
+/* Fixed-point engine for band-limited presets on 16-bit PCM. A float
+   chain is built as usual for its filter design, then converted: samples
+   run as int32 Q24 (7 bits of headroom over full scale, 8 bits below the
+   16-bit step), biquads in direct form I with Q28 coefficients, 64-bit
+   accumulators and first-order error feedback, tanh from an interpolated
+   table, bitcrush and clip in integer arithmetic. Every result saturates.
+   A peak normalize inside the chain is resolved by an analysis pass over
+   the input, as in streaming mode. A final one needs no extra pass: tiles
+   are kept in the output buffer as 16-bit mantissas of their own peak and
+   rescaled once the file peak is known, so nothing between the mapped
+   input and the output frames is wider than 16 bits per sample.
+
+   Head stages, noise, modulation, reverb and RMS normalize have no
+   fixed-point form; chains with them stay on the float path. */
+#define FIXED_FRAC       24
+#define FIXED_ONE        (1 << FIXED_FRAC)
+#define FIXED_COEF_FRAC  28           /* biquad coefficients, |c| < 8 */
+#define FIXED_TANH_N     4096         /* table segments */
+#define FIXED_BLOCK      1024         /* frames per tile */
+
+/* x * g as (x * m + round) >> sh */
+typedef struct {
+    int32_t m;
+    int     sh;
+} FixedGain;
+
+typedef struct {
+    int32_t b0, b1, b2, a1, a2;
+} FixedBiquad;
+
+typedef struct {
+    int32_t x1, x2, y1, y2;
+    int64_t err;
+} FixedBiquadState;
+
+typedef struct {
+    FixedBiquadState z[SOS_MAX_STAGES];
+    int32_t   peak;       /* analysis: max |x| */
+    FixedGain g;          /* resolved peak normalize */
+} FixedChanState;
+
+typedef struct {
+    StageKind       kind;
+    float           a;
+    int             nsec;
+    FixedBiquad     sec[SOS_MAX_STAGES];
+    FixedGain       gain;
+    int32_t        *tanh;         /* FIXED_TANH_N + 1 points, 2^tanh_sh apart */
+    int             tanh_sh;
+    int32_t         crush_levels; /* 2^bits - 1 */
+    int64_t         crush_step;   /* 2 / levels in Q40 */
+    FixedChanState *ch;
+} FixedStage;
+
+typedef struct {
+    FixedStage *st;
+    int         nst;
+    int         nrun;     /* stages run per sample; a final normalize rescales */
+    uint16_t    nch;
+    Arena      *mem;
+} FixedChain;
+
+FixedGain fixed_gain(double g);
+
+/* 1 when every stage of c has a fixed-point form */
+int  fixed_chain_supported(const FxChain *c);
+/* 0 when unsupported or out of memory; state comes from `mem` as in chain_init() */
+int  fixed_chain_init(FixedChain *f, const FxChain *c, Arena *mem);
+void fixed_chain_free(FixedChain *f);
+
+/* src and dst hold the whole signal, n interleaved little-endian PCM16
+   frames; 0 if out of memory */
+int  fixed_chain_process(FixedChain *f, const uint8_t *src, uint8_t *dst, uint32_t n);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef FPMODE_H
+#define FPMODE_H
+
+#include "compat.h"
+
+/* Optional flush-to-zero/denormals-are-zero for processing threads: MXCSR
+   FTZ|DAZ on x86, FPCR.FZ on AArch64, nothing elsewhere. The flag is
+   process-wide and set once at startup; every thread that runs chains
+   calls fpmode_apply() before its first job. Off by default: the kernels
+   already keep their state out of the subnormal range, and with it on a
+   subnormal input sample is read as zero, so output may differ in the
+   last bits from a default run. */
+void fpmode_set_ftz(int on);
+int  fpmode_ftz(void);
+/* applies the flag to the calling thread; 0 if unsupported here */
+int  fpmode_apply(void);
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef LIVE_H
+#define LIVE_H
+
+#include "render.h"
+
+/* Real-time filter: PCM from stdin, WAV-headed or raw, through one preset
+   to raw PCM on stdout in fixed blocks. Each block is written as soon as
+   it is processed; after the input ends the chain is run on silence for
+   its latency so nothing of the input is cut. The algorithmic latency and
+   per-block processing time percentiles go to stderr. */
+typedef struct {
+    uint32_t block;
+    uint32_t rate;          /* raw input only */
+    uint16_t channels;      /* raw input only */
+    WavFormat in_format;    /* raw input only */
+} LiveOptions;
+
+int live_run(const LiveOptions *lo, const PresetBook *book, int preset, const RenderOptions *opt);
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef OSC_H
+#define OSC_H
+
+#include "compat.h"
+
+/* Table-free sine LFO. Four consecutive samples are held as complex
+   phasors and advanced together by one rotation of 4*dph, so the inner
+   loop is a vector complex multiply. Every OSC_RESYNC samples of absolute
+   position the phasors are re-anchored to the exact phase (computed in
+   double). That keeps the error below 2e-6 and makes the output depend
+   only on the sample index, not on how it is split into blocks. */
+#define OSC_RESYNC 512
+
+typedef struct {
+    double   phase0, dph;
+    uint64_t i;
+    float    wr, wi;
+    float    qr[4], qi[4];
+} Osc;
+
+void osc_init(Osc *o, float sr, float f_hz, float phase);
+void osc_reset(Osc *o);
+void osc_sin_block(Osc *o, float *out, uint32_t n);
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef PITCH_H
+#define PITCH_H
+
+#include "compat.h"
+#include "stream.h"
+#include "arena.h"
+
+/* Duration-preserving pitch shifter (WSOLA-style granular overlap-add).
+   Two Hann grains of G samples overlap by half and read a ring buffer of
+   the input at `ratio` samples per output sample. Each new grain is placed
+   within +-S samples of its nominal position by normalized
+   cross-correlation with the grain it replaces. Output is the shifted input
+   delayed by a fixed `latency` frames; memory does not depend on the signal
+   length. Ratios are clamped to [PITCH_RATIO_MIN, PITCH_RATIO_MAX], two
+   octaves either way, by init and latency alike. */
+#define PITCH_RATIO_MIN 0.25f
+#define PITCH_RATIO_MAX 4.0f
+
+typedef struct {
+    float   *buf;          /* input ring, mask+1 samples */
+    float   *win;          /* G-point periodic Hann */
+    float   *ref, *reg;    /* correlation scratch: W and 2S+W samples, each
+                              followed by a copy decimated by 4 */
+    uint32_t mask;
+    uint32_t G, H, S, W;
+    uint32_t latency;
+    uint32_t ph;           /* position within the current hop */
+    float    ratio;
+    uint32_t step_i;       /* ratio split into whole and fractional steps */
+    float    step_f;
+    int64_t  t;            /* input frames written */
+    int64_t  ia, ib;       /* read positions of the fading-out/-in grains */
+    float    fa, fb;
+    Arena   *mem;
+} PitchShifter;
+
+uint32_t pitch_shifter_latency(float sr, float ratio);
+int      pitch_shifter_init(PitchShifter *p, float sr, float ratio, Arena *mem);
+void     pitch_shifter_reset(PitchShifter *p);
+void     pitch_shifter_process(PitchShifter *p, float *x, uint32_t n);
+void     pitch_shifter_free(PitchShifter *p);
+
+/* Pull adaptor for the chain head: one shifter per channel, with the
+   latency compensated by reading ahead (the source tail is zero-padded),
+   so the output lines up with the input and keeps its length. */
+typedef struct {
+    FxSource      base;
+    FxSource     *up;
+    PitchShifter *ps;
+    uint32_t      chunk, skip, pos;
+    int           eof;
+    int           live;
+    float       **tmp;
+    Arena        *mem;
+} PitchSource;
+
+int  pitch_source_init(PitchSource *p, FxSource *up, float sr, float ratio, uint32_t block,
+                       Arena *mem);
+void pitch_source_free(PitchSource *p);
+/* no read-ahead and no length limit: the output lags the input by the
+   latency, and every read consumes exactly as many frames as it returns */
+void pitch_source_set_live(PitchSource *p);
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include "compat.h"
+#include "arena.h"
+
+/* Fixed-size worker pool with a FIFO job queue. With 0 workers,
+   pool_submit() runs the job on the calling thread. Every worker owns a
+   scratch arena of at least `arena_bytes`, reset before each job and
+   handed to it, so consecutive jobs reuse the same pages. */
+typedef void (*PoolFn)(void *arg, Arena *scratch);
+
+typedef struct ThreadPool ThreadPool;
+
+ThreadPool* pool_create(int nthreads, size_t arena_bytes);
+int         pool_submit(ThreadPool *p, PoolFn fn, void *arg);
+void        pool_wait(ThreadPool *p);
+int         pool_queued(ThreadPool *p);     /* submitted, not yet started */
+void        pool_destroy(ThreadPool *p);
+int         pool_default_threads(void);
+
+#endif
@@ -3,6 +3,8 @@
 
 #include "compat.h"
 #include "dsp.h"
+#include "chain.h"
+#include "chainspec.h"
 
 typedef enum {
     PRESET_NONE,
@@ -25,10 +27,47 @@ typedef enum {
     PRESET_BARITONE,
     PRESET_DEEP_VOICE,
     PRESET_WHISPERISH,
-    PRESET_PITCH_UP_FUN
+    PRESET_PITCH_UP_FUN,
+    PRESET_COUNT
 } Preset;
 
-Preset parse_preset(const char *s);
-void   apply_preset_chain(float *x, uint32_t n, float sr, Preset p);
+Preset      parse_preset(const char *s);
+const char *preset_name(Preset p);
+int         preset_build_chain(FxChain *c, Preset p, float sr, uint16_t nch, Arena *mem);
+/* one mono buffer through preset p; seed drives its noise stages as --seed does */
+void   apply_preset_chain(float *x, uint32_t n, float sr, Preset p, uint32_t seed);
+
+/* Every preset is a ChainSpec. A book starts with the built-ins, in Preset
+   order, and takes more from text: "[name]" opens a preset (replacing a
+   built-in of the same name), the lines after it are its stages.
+
+     [radio_dark]
+     bandlimit 90 4000    # muffled
+     rms_norm -20
+     tanh 3
+*/
+#define PRESET_NAME_MAX 64
+
+typedef struct {
+    char      name[PRESET_NAME_MAX];
+    ChainSpec spec;
+} PresetDef;
+
+typedef struct {
+    PresetDef *v;
+    int        n, cap;
+} PresetBook;
+
+int  preset_book_init(PresetBook *b);
+int  preset_book_find(const PresetBook *b, const char *name);
+/* Comma-separated names (NULL or "all" for every preset) to indices in
+   sel[], which has room for b->n; the count, or -1 with *bad set to the
+   unknown name. Splits `list` in place. */
+int  preset_book_select(const PresetBook *b, char *list, int *sel, const char **bad);
+/* on failure *bad_line is the failing line, or 0 if the file could not be read */
+int  preset_book_load(PresetBook *b, const char *text, int *bad_line);
+int  preset_book_load_file(PresetBook *b, const char *path, int *bad_line);
+int  preset_book_build(const PresetBook *b, int i, FxChain *c, float sr, uint16_t nch, Arena *mem);
+void preset_book_free(PresetBook *b);
 
 #endif
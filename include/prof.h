@@ -0,0 +1,49 @@
+#ifndef PROF_H
+#define PROF_H
+
+#include "compat.h"
+
+/* Per-stage chain profile, built in with PROFILE=1 and compiled out
+   otherwise. Every stage call is timed per channel: wall time, cycles,
+   and, where perf_event_open is allowed, instructions and cache misses
+   read in user space. Stats are merged by (preset, stage, channel) when
+   a chain is freed; prof_report() prints them and prof_write_trace()
+   writes every call as a Chrome trace event (chrome://tracing, Perfetto). */
+#ifndef PROFILE
+#define PROFILE 0
+#endif
+
+#if PROFILE
+
+#define PROF_TRACE_MAX (1u << 18)   /* events kept; later ones are only counted */
+#define PROF_ALL_CH    (-1)         /* a call over all channels at once (SIMD lanes, head) */
+
+typedef struct {
+    uint64_t calls, samples, bytes;
+    uint64_t ns, cycles, instr, misses;
+} ProfStat;
+
+typedef struct {
+    uint64_t ns, cycles, instr, misses;
+} ProfMark;
+
+/* stable copy of s for stat and trace names */
+const char* prof_intern(const char *s);
+void prof_begin(ProfMark *m);
+void prof_end(const ProfMark *m, ProfStat *st, uint32_t n, uint64_t bytes,
+              const char *name, const char *cat, int ch);
+void prof_add(const char *preset, int stage, const char *name, int ch, const ProfStat *st);
+void prof_report(const char *label);
+int  prof_write_trace(const char *path);
+
+#define PROF_BEGIN(m)                                  ProfMark m; prof_begin(&m)
+#define PROF_END(m, st, n, bytes, name, cat, ch)       prof_end(&m, st, n, bytes, name, cat, ch)
+
+#else
+
+#define PROF_BEGIN(m)
+#define PROF_END(m, st, n, bytes, name, cat, ch)
+
+#endif
+
+#endif
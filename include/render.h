@@ -0,0 +1,76 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include "compat.h"
+#include "wav.h"
+#include "presets.h"
+
+typedef struct {
+    uint32_t  block;
+    uint32_t  seed;
+    TanhMode  tanh_mode;
+    FilterMode filter_mode;
+    int       out_format;     /* WavFormat, or -1 for the input's own */
+    int       streaming;
+    int       fixed;          /* fixed-point path where it applies */
+} RenderOptions;
+
+typedef enum {
+    RENDER_OK,
+    RENDER_ERR_OPEN,
+    RENDER_ERR_FORMAT,
+    RENDER_ERR_LENGTH,
+    RENDER_ERR_SHORT,
+    RENDER_ERR_NOMEM
+} RenderStatus;
+
+/* One input file, opened once and shared read-only by every preset
+   rendered from it. In memory mode the data chunk is mapped; streaming
+   renders read it block by block through their own WavSource. */
+typedef struct {
+    FILE          *f;
+    int            fd;
+    WavInfo        wi;
+    WavMap         map;
+    const uint8_t *pcm;
+    uint32_t       nframes;
+    uint32_t       block;
+    uint32_t       seed;
+    TanhMode       tanh_mode;
+    FilterMode     filter_mode;
+    WavFormat      out_format;
+    int            streaming;
+    int            fixed;
+} RenderInput;
+
+RenderStatus render_input_open(RenderInput *in, const char *path, const RenderOptions *opt);
+void         render_input_close(RenderInput *in);
+const char*  render_status_text(RenderStatus s);
+
+/* scratch a worker needs for one preset of this input */
+size_t   render_arena_bytes(const RenderInput *in);
+uint32_t render_latency(const PresetBook *b, int preset, uint32_t sample_rate);
+
+/* 1 when preset `preset` renders on the fixed-point engine (fixed.h):
+   asked for, memory mode, PCM16 in and out, and every stage supported */
+int render_uses_fixed(const RenderInput *in, const PresetBook *b, int preset);
+
+/* Renders preset `preset` of `b` to `path`; 1 on success. The noise seed
+   depends on the preset's index in the book, so the same preset renders
+   identically whichever subset of presets is asked for. */
+int render_preset(const RenderInput *in, const PresetBook *b, int preset, const char *path,
+                  Arena *scratch);
+
+/* Memory mode split by channel: channels c0 .. c0+nc-1 of the preset into
+   x[c0 ..] (nframes long) with their deferred gains in gain[c0 ..], the
+   same samples those channels get from render_preset(); render_write()
+   stores the gathered planes. */
+int render_channels(const RenderInput *in, const PresetBook *b, int preset, uint16_t c0, uint16_t nc,
+                    float **x, float *gain, Arena *scratch);
+/* channels per task when one preset's ch channels are spread over `tasks`
+   workers: single channels while there are enough tasks, otherwise whole
+   groups of SIMD_LANES so filter cascades fill all their lanes */
+uint16_t render_split_width(uint16_t ch, int tasks);
+int render_write(const RenderInput *in, const char *path, float *const *x, const float *gain);
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+#include "compat.h"
+#include "stream.h"
+#include "arena.h"
+
+/* Polyphase windowed-sinc resampler. The ratio is approximated by L/M
+   (L, M <= RS_MAX_PHASES); each of the L phases holds `taps` Kaiser-windowed
+   sinc coefficients normalized to unity DC gain. Banks are immutable, built
+   once per (L, M, quality) and shared between threads through a cache. */
+#define RS_MAX_PHASES 1024
+
+typedef enum {
+    RS_QUALITY_FAST,      /*  8 taps, beta 6,  rolloff 0.85 */
+    RS_QUALITY_MEDIUM,    /* 16 taps, beta 8,  rolloff 0.90 */
+    RS_QUALITY_HIGH       /* 32 taps, beta 10, rolloff 0.94 */
+} ResampleQuality;
+
+typedef struct {
+    uint32_t L, M;
+    int      taps;        /* per phase, multiple of 4 */
+    float   *h;           /* L * taps */
+} ResampleBank;
+
+void                resample_ratio_rational(double ratio, uint32_t *L, uint32_t *M);
+const ResampleBank* resample_bank_get(uint32_t L, uint32_t M, ResampleQuality q);
+void                resample_cache_clear(void);
+
+/* Streaming state: inputs are pushed in any chunk size, outputs land in
+   caller buffers, and the filter history is carried between calls. Output
+   k is centred on input position k*M/L; inputs before the first are zero. */
+typedef struct {
+    const ResampleBank *bank;
+    uint16_t  nch;
+    uint32_t  cap, fill;
+    int64_t   base;        /* input index of buf[c][0] */
+    int64_t   idx;         /* integer input position of the next output */
+    uint32_t  phase;       /* fractional position, in 1/L units */
+    uint32_t  step_i, step_f;
+    float   **buf;
+    Arena    *mem;
+} Resampler;
+
+int      resampler_init(Resampler *r, const ResampleBank *bank, uint16_t nch, uint32_t chunk,
+                        Arena *mem);
+void     resampler_reset(Resampler *r);
+void     resampler_free(Resampler *r);
+uint32_t resampler_process(Resampler *r, float *const *in, uint32_t n_in, uint32_t *consumed,
+                           float **out, uint32_t out_cap);
+
+/* Pull adaptor for the chain head: output length floor(n*L/M), input
+   past the end of the upstream source reads as zeros. */
+typedef struct {
+    FxSource  base;
+    FxSource *up;
+    Resampler rs;
+    uint32_t  chunk, pend, used, pos;
+    float   **tmp;
+} PolyResampler;
+
+int  poly_resampler_init(PolyResampler *p, FxSource *up, float ratio, ResampleQuality q,
+                         uint32_t block, Arena *mem);
+void poly_resampler_free(PolyResampler *p);
+
+#endif
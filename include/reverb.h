@@ -0,0 +1,84 @@
+#ifndef REVERB_H
+#define REVERB_H
+
+#include "compat.h"
+#include "arena.h"
+
+/* Ring-buffer delay line; the buffer is the next power of two above the
+   longest delay, never the signal length. */
+typedef struct {
+    float   *buf;
+    uint32_t mask, pos;
+    Arena   *mem;
+} DelayLine;
+
+/* 0 when max_delay is 2^31 or more, or out of memory */
+int  delay_init(DelayLine *d, uint32_t max_delay, Arena *mem);
+void delay_reset(DelayLine *d);
+void delay_free(DelayLine *d);
+
+static inline float delay_read(const DelayLine *d, uint32_t delay){
+    return d->buf[(d->pos - delay) & d->mask];
+}
+static inline void delay_write(DelayLine *d, float v){
+    d->buf[d->pos] = v;
+    d->pos = (d->pos + 1) & d->mask;
+}
+
+#define TAPDELAY_MAX_TAPS 8
+
+/* feed-forward multi-tap echo: y[i] = x[i] + sum g[k]*x[i-d[k]] */
+typedef struct {
+    DelayLine dl;
+    int       ntaps;
+    uint32_t  d[TAPDELAY_MAX_TAPS];
+    float     g[TAPDELAY_MAX_TAPS];
+} TapDelay;
+
+int  tapdelay_init(TapDelay *t, const uint32_t *d, const float *g, int ntaps, Arena *mem);
+void tapdelay_reset(TapDelay *t);
+void tapdelay_process(TapDelay *t, float *x, uint32_t n);
+void tapdelay_free(TapDelay *t);
+
+/* 4-line feedback delay network: orthogonal (Hadamard) mixing, per-line
+   decay set from RT60 and a one-pole damping lowpass in each loop. */
+#define FDN_LINES 4
+
+typedef struct {
+    DelayLine line[FDN_LINES];
+    uint32_t  len[FDN_LINES];
+    float     g[FDN_LINES];
+    float     lp[FDN_LINES];
+    float     damp;
+} Fdn;
+
+int  fdn_init(Fdn *f, float sr, const float *delay_sec, float rt60, float damping, Arena *mem);
+void fdn_reset(Fdn *f);
+void fdn_free(Fdn *f);
+
+#define REVERB_MAX_SEC 10.0f    /* longest tap or FDN line a spec may ask for */
+
+typedef struct {
+    int   ntaps;
+    float tap_sec[TAPDELAY_MAX_TAPS];
+    float tap_gain[TAPDELAY_MAX_TAPS];
+    float fdn_sec[FDN_LINES];   /* all zero: early reflections only */
+    float rt60;
+    float damping;
+    float wet;
+} ReverbParams;
+
+/* early reflections on the dry path plus an FDN tail fed by the dry input */
+typedef struct {
+    TapDelay early;
+    Fdn      fdn;
+    int      has_early, has_fdn;
+    float    wet;
+} Reverb;
+
+int  reverb_init(Reverb *r, float sr, const ReverbParams *p, Arena *mem);
+void reverb_reset(Reverb *r);
+void reverb_process(Reverb *r, float *x, uint32_t n);
+void reverb_free(Reverb *r);
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include "compat.h"
+
+/* Per-instance random source: four xoshiro128++ streams advanced together
+   in SIMD lanes fill a word buffer, and a 128-layer Ziggurat turns words
+   into normal deviates (one table lookup and compare for ~99% of draws).
+   No global state; the same seed gives the same sequence on every thread,
+   however the output is split into blocks. */
+#define RNG_BUF 64
+
+typedef struct {
+    uint32_t s[4][4];       /* s[word][lane] */
+    uint32_t buf[RNG_BUF];
+    uint32_t pos;
+} Rng;
+
+void     rng_seed(Rng *r, uint64_t seed);
+uint32_t rng_u32(Rng *r);
+float    rng_uniform(Rng *r);           /* (0, 1] */
+float    rng_normal(Rng *r);
+void     rng_normal_block(Rng *r, float *out, uint32_t n);
+
+#endif
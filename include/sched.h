@@ -0,0 +1,24 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#include "compat.h"
+#include "arena.h"
+
+/* Work-stealing scheduler for batches whose tasks vary wildly in size.
+   Every worker owns a deque and takes its own work from the back, so a
+   deque filled smallest first is worked largest first, and pieces a task
+   splits off stay hot with the worker that split them. An idle worker
+   steals from the front of someone else's deque. Tasks may push more
+   tasks; sched_run() returns once none is queued or running. Like the
+   pool, every worker owns a scratch arena reset before each task. */
+typedef struct Sched Sched;
+typedef void (*SchedFn)(void *arg, Arena *scratch, Sched *s, int worker);
+
+Sched*   sched_create(int nworkers, size_t arena_bytes);
+/* worker < 0 spreads tasks round-robin; inside a task pass its own index */
+int      sched_push(Sched *s, int worker, SchedFn fn, void *arg);
+int      sched_run(Sched *s);
+uint64_t sched_steals(Sched *s);
+void     sched_destroy(Sched *s);
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "render.h"
+
+/* Batch daemon. Listens on a Unix domain socket and renders requests on
+   one persistent pool of `threads` workers, so the preset book, worker
+   threads and their arenas are set up once for any number of jobs.
+
+   The protocol is one request per line, one reply line per request:
+
+     render <in.wav> <out> [preset,preset,...|all]
+         -> ok <outputs> <ms>  |  err <message>
+     stats
+         -> stats done=.. failed=.. active=.. queued=.. p50_ms=.. p95_ms=.. p99_ms=.. max_ms=..
+     quit                      closes the connection
+     shutdown                  finishes running jobs and exits
+
+   <out> is a directory that receives <preset>.wav, or a .wav path when a
+   single preset is asked for. Requests on one connection run one after
+   another; clients open several connections to keep the workers busy.
+   Returns 0 if the socket could not be set up. */
+int serve(const char *sock_path, const PresetBook *book, const RenderOptions *opt, int threads);
+
+#endif
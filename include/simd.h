@@ -0,0 +1,25 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+/* 4-lane float vectors through GCC/Clang vector extensions: SSE on x86-64,
+   NEON on AArch64, plain scalar code elsewhere. Element-wise arithmetic is
+   IEEE-identical to the scalar expressions it replaces. */
+#if defined(__GNUC__)
+#define SIMD_VEC 1
+typedef float    v4sf __attribute__((vector_size(16)));
+typedef int32_t  v4si __attribute__((vector_size(16)));
+typedef uint32_t v4su __attribute__((vector_size(16)));
+typedef int16_t  v4hi __attribute__((vector_size(8)));
+/* lanes i..l of the concatenation of a and b (0-3 from a, 4-7 from b) */
+#if defined(__clang__) || __GNUC__ >= 12
+#define SIMD_SHUF(a, b, i, j, k, l) __builtin_shufflevector(a, b, i, j, k, l)
+#else
+#define SIMD_SHUF(a, b, i, j, k, l) __builtin_shuffle(a, b, (v4si){i, j, k, l})
+#endif
+#else
+#define SIMD_VEC 0
+#endif
+
+#define SIMD_LANES 4
+
+#endif
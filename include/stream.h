@@ -0,0 +1,24 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include "compat.h"
+
+/* Pull-based planar audio source. read() fills up to `count` frames into
+   dst[0..nch-1] and returns the number of frames produced (0 at the end). */
+typedef struct FxSource FxSource;
+struct FxSource {
+    uint32_t (*read)(FxSource *s, float **dst, uint32_t count);
+    void     (*rewind)(FxSource *s);
+    uint32_t length;
+    uint16_t nch;
+};
+
+typedef struct {
+    FxSource     base;
+    float *const *x;
+    uint32_t     pos;
+} MemSource;
+
+void mem_source_init(MemSource *m, float *const *x, uint32_t n, uint16_t nch);
+
+#endif
@@ -2,25 +2,113 @@
 #define WAV_H
 
 #include "compat.h"
+#include "stream.h"
+
+/* sample encodings read and written natively */
+typedef enum {
+    WAV_PCM16,
+    WAV_PCM24,
+    WAV_PCM32,
+    WAV_FLOAT32
+} WavFormat;
 
 typedef struct {
-    uint16_t audio_format;
-    uint16_t num_channels;
-    uint32_t sample_rate;
-    uint32_t byte_rate;
-    uint16_t block_align;
-    uint16_t bits_per_sample;
-    uint32_t data_size;
-    long     data_offset;
+    uint16_t  audio_format;     /* 1 or 3; WAVE_FORMAT_EXTENSIBLE is resolved */
+    uint16_t  num_channels;
+    uint32_t  sample_rate;
+    uint32_t  byte_rate;
+    uint16_t  block_align;
+    uint16_t  bits_per_sample;
+    uint64_t  data_size;        /* from ds64 in RF64 files */
+    long      data_offset;
+    WavFormat format;
+    int       rf64;
 } WavInfo;
 
-int  read_wav_header(FILE *f, WavInfo *info);
-int  write_wav_file(const char *path, const float *interleaved, uint32_t nframes,
-                    uint16_t channels, uint32_t sample_rate);
+int      read_wav_header(FILE *f, WavInfo *info);
+/* for a stream that cannot seek, whose first four bytes ("RIFF"/"RF64")
+   the caller has already read; f is left at the first sample */
+int      read_wav_header_pipe(FILE *f, const uint8_t magic[4], WavInfo *info);
+int      write_wav_file(const char *path, const float *interleaved, uint32_t nframes,
+                        uint16_t channels, uint32_t sample_rate);
+uint32_t wav_format_bytes(WavFormat fmt);
+
+/* Frames in the encoding of `fmt` to float: every channel into planar
+   buffers, or just channel c. Integer samples are scaled by 2^-(bits-1);
+   float samples pass through unchanged. */
+void wav_decode(float *const *dst, const uint8_t *src, WavFormat fmt, uint16_t ch, uint32_t n);
+/* channels c0 .. c0+nc-1 into dst[0 .. nc-1] */
+void wav_decode_channels(float *const *dst, const uint8_t *src, WavFormat fmt, uint16_t ch,
+                         uint16_t c0, uint16_t nc, uint32_t n);
+void wav_decode_channel(float *dst, const uint8_t *src, WavFormat fmt, uint16_t ch, uint16_t c,
+                        uint32_t n);
+/* planar float to frames in the encoding of `fmt`, quantized as the
+   writer does */
+void wav_encode(uint8_t *dst, float *const *src, WavFormat fmt, uint16_t ch, uint32_t n);
+
+/* The data chunk of an already parsed file, mapped read-only (or read into
+   memory when the file cannot be mapped). nframes counts only the frames
+   actually present in the file. */
+typedef struct {
+    void          *base;
+    size_t         len;
+    uint8_t       *copy;
+    const uint8_t *data;
+    uint32_t       nframes;
+} WavMap;
+
+int  wav_map_open(WavMap *m, int fd, const WavInfo *info);
+void wav_map_close(WavMap *m);
+
+/* Reads the data chunk of an already parsed file block by block, straight
+   from the mapping when there is one. */
+typedef struct {
+    FxSource       base;
+    int            fd;
+    long           data_offset;
+    WavFormat      format;
+    uint32_t       pos, cap;
+    uint32_t       avail;        /* frames present in a mapped file */
+    void          *map;
+    size_t         map_len, released;
+    const uint8_t *data;
+    uint8_t       *pcm;
+} WavSource;
+
+int  wav_source_open(WavSource *w, int fd, const WavInfo *info, uint32_t block);
+void wav_source_close(WavSource *w);
+
+/* Writes a file of known length in any WavFormat; sizes past 4 GiB switch
+   the header to RF64 with a ds64 chunk. The file is preallocated and mapped
+   when the filesystem allows it, so samples are converted straight into the
+   page cache; otherwise they are staged in a large buffer and written with
+   write(). Integer samples are quantized as lrint(clamp(s) * (2^(bits-1)-1)).
+   Every call returns 0 once any write has failed; close reports it too. */
+typedef struct {
+    int       fd;
+    uint16_t  channels;
+    WavFormat format;
+    uint32_t  nframes, done;
+    size_t    hdr_len;
+    uint8_t  *map;          /* whole file when mapped */
+    size_t    map_len, released;
+    uint8_t  *bytes;        /* staging buffer otherwise */
+    size_t    cap, fill;
+    int       err;
+} WavWriter;
+
+int  wav_writer_open(WavWriter *w, const char *path, uint32_t nframes, uint16_t channels,
+                     uint32_t sample_rate, WavFormat fmt, uint32_t block);
+int  wav_writer_write(WavWriter *w, float *const *planar, uint32_t nframes);
+/* planar[c][i] * gain[c] is what gets stored; gain NULL is unity */
+int  wav_writer_write_scaled(WavWriter *w, float *const *planar, const float *gain, uint32_t nframes);
+int  wav_writer_write_interleaved(WavWriter *w, const float *x, uint32_t nframes);
+/* frames already in the writer's encoding, copied as they are */
+int  wav_writer_write_raw(WavWriter *w, const uint8_t *frames, uint32_t nframes);
+int  wav_writer_close(WavWriter *w);
 
-void split_interleaved_to_planar(const float *in, float *L, float *R,
-                                 uint32_t nframes, uint16_t ch);
-void join_planar_to_interleaved(float *out, const float *L, const float *R,
-                                uint32_t nframes, uint16_t ch);
+/* interleaved float frames of any channel count to and from planes */
+void split_interleaved_to_planar(const float *in, float *const *dst, uint32_t nframes, uint16_t ch);
+void join_planar_to_interleaved(float *out, float *const *src, uint32_t nframes, uint16_t ch);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,129 @@
+#include "arena.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define ARENA_MIN_SPILL (256u << 10)
+
+struct ArenaBlock {
+    ArenaBlock *next;
+    size_t      len, used;
+};
+
+static size_t page_round(size_t n){
+    static size_t page;
+    if (!page){
+        long p = sysconf(_SC_PAGESIZE);
+        page = p > 0 ? (size_t)p : 4096;
+    }
+    return (n + page - 1) & ~(page - 1);
+}
+
+static void* map_pages(size_t len){
+    void *p = mmap(NULL, len, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    return p == MAP_FAILED ? NULL : p;
+}
+
+static size_t align_up(size_t n){
+    return (n + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+int arena_init(Arena *a, size_t cap){
+    memset(a,0,sizeof(*a));
+    if (!cap) return 1;
+    a->cap = page_round(cap);
+    a->base = (uint8_t*)map_pages(a->cap);
+    if (!a->base){ a->cap = 0; return 0; }
+    return 1;
+}
+
+static void drop_spill(Arena *a){
+    while (a->spill){
+        ArenaBlock *b = a->spill;
+        a->spill = b->next;
+        munmap(b, b->len);
+    }
+    a->spilled = 0;
+}
+
+void arena_reset(Arena *a){
+    size_t need = a->used + a->spilled;
+    if (need > a->peak) a->peak = need;
+    if (a->spill){
+        /* one block big enough for the whole of the last job; if the map
+           fails the old block stays and the next job spills again */
+        size_t cap = page_round(a->peak);
+        uint8_t *base = (uint8_t*)map_pages(cap);
+        drop_spill(a);
+        if (base){
+            if (a->base) munmap(a->base, a->cap);
+            a->base = base;
+            a->cap = cap;
+        }
+    }
+    a->used = 0;
+}
+
+void arena_destroy(Arena *a){
+    drop_spill(a);
+    if (a->base) munmap(a->base, a->cap);
+    memset(a,0,sizeof(*a));
+}
+
+void* arena_alloc(Arena *a, size_t bytes){
+    if (!bytes) bytes = 1;
+    if (!a){
+        void *p = NULL;
+        return posix_memalign(&p, ARENA_ALIGN, align_up(bytes)) == 0 ? p : NULL;
+    }
+    bytes = align_up(bytes);
+    if (a->cap - a->used >= bytes){
+        void *p = a->base + a->used;
+        a->used += bytes;
+        return p;
+    }
+    ArenaBlock *b = a->spill;
+    size_t hdr = align_up(sizeof(ArenaBlock));
+    if (!b || b->len - b->used < bytes){
+        size_t want = bytes > a->cap ? bytes : a->cap;
+        if (want < ARENA_MIN_SPILL) want = ARENA_MIN_SPILL;
+        size_t len = page_round(hdr + want);
+        b = (ArenaBlock*)map_pages(len);
+        if (!b) return NULL;
+        b->next = a->spill;
+        b->len = len;
+        b->used = hdr;
+        a->spill = b;
+    }
+    void *p = (uint8_t*)b + b->used;
+    b->used += bytes;
+    a->spilled += bytes;
+    return p;
+}
+
+void* arena_calloc(Arena *a, size_t n, size_t size){
+    if (size && n > SIZE_MAX / size) return NULL;
+    void *p = arena_alloc(a, n*size);
+    if (p) memset(p, 0, n*size);
+    return p;
+}
+
+void arena_free(Arena *a, void *p){
+    if (!a) free(p);
+}
+
+float** arena_planes(Arena *a, uint16_t n, uint32_t len){
+    float **x = (float**)arena_calloc(a, n, sizeof(float*));
+    if (!x) return NULL;
+    for (uint16_t c=0;c<n;c++){
+        x[c] = (float*)arena_alloc(a, sizeof(float)*(len ? len : 1));
+        if (!x[c]){ arena_free_planes(a, x, n); return NULL; }
+    }
+    return x;
+}
+
+void arena_free_planes(Arena *a, float **x, uint16_t n){
+    if (!x || a) return;
+    for (uint16_t c=0;c<n;c++) free(x[c]);
+    free(x);
+}
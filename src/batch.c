@@ -0,0 +1,337 @@
+#include "batch.h"
+#include "sched.h"
+
+#include <dirent.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <strings.h>
+
+#define BATCH_PATH_MAX 4096
+
+typedef struct Batch Batch;
+
+/* opened by the first of its outputs to run, closed by the last */
+typedef struct {
+    char            *path;
+    char             name[256];
+    off_t            size;
+    pthread_mutex_t  mu;
+    RenderInput      in;
+    int              state;      /* 0 unopened, 1 open, -1 failed */
+    double           seconds;
+    atomic_int       left;
+} BatchFile;
+
+typedef struct BatchOut BatchOut;
+
+typedef struct {
+    BatchOut *out;
+    uint16_t  c0, nc;
+} BatchChan;
+
+/* one preset of one file; split into BatchChan channel groups for long files */
+struct BatchOut {
+    Batch      *b;
+    BatchFile  *f;
+    int         preset;
+    float     **x;
+    float      *gain;
+    BatchChan  *chans;
+    atomic_int  chans_left;
+    atomic_int  failed;
+};
+
+struct Batch {
+    const BatchOptions *bo;
+    const PresetBook   *book;
+    RenderOptions       opt;
+    BatchFile          *files;
+    int                 nfiles;
+    atomic_int          ok, bad;
+};
+
+static double now_sec(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void output_path(char *buf, size_t cap, const char *tmpl, const char *name, const char *preset){
+    size_t n = 0;
+    while (*tmpl && n + 1 < cap){
+        const char *sub = NULL;
+        if (strncmp(tmpl, "{name}", 6) == 0){ sub = name; tmpl += 6; }
+        else if (strncmp(tmpl, "{preset}", 8) == 0){ sub = preset; tmpl += 8; }
+        if (sub) while (*sub && n + 1 < cap) buf[n++] = *sub++;
+        else buf[n++] = *tmpl++;
+    }
+    buf[n] = 0;
+}
+
+static void make_parents(const char *path){
+    char dir[BATCH_PATH_MAX];
+    snprintf(dir, sizeof(dir), "%s", path);
+    for (char *p = dir + 1; *p; p++){
+        if (*p != '/') continue;
+        *p = 0;
+        MKDIR_P(dir);
+        *p = '/';
+    }
+}
+
+static int batch_open(Batch *b, BatchFile *f){
+    pthread_mutex_lock(&f->mu);
+    if (f->state == 0){
+        RenderStatus st = render_input_open(&f->in, f->path, &b->opt);
+        if (st == RENDER_OK){
+            f->state = 1;
+            f->seconds = (double)f->in.nframes / f->in.wi.sample_rate;
+        } else {
+            f->state = -1;
+            fprintf(stderr, "%s: %s\n", f->path, render_status_text(st));
+        }
+    }
+    int ok = f->state == 1;
+    pthread_mutex_unlock(&f->mu);
+    return ok;
+}
+
+static void batch_done(BatchOut *o, int ok, const char *path){
+    Batch *b = o->b;
+    BatchFile *f = o->f;
+    if (ok) atomic_fetch_add(&b->ok, 1);
+    else {
+        atomic_fetch_add(&b->bad, 1);
+        if (path) fprintf(stderr, "Faylni saqlashda xatolik %s\n", path);
+    }
+    if (atomic_fetch_sub(&f->left, 1) == 1 && f->state == 1) render_input_close(&f->in);
+}
+
+static void batch_channel(void *arg, Arena *scratch, Sched *s, int worker){
+    (void)s; (void)worker;
+    BatchChan *k = (BatchChan*)arg;
+    BatchOut *o = k->out;
+    const RenderInput *in = &o->f->in;
+    if (!render_channels(in, o->b->book, o->preset, k->c0, k->nc, o->x, o->gain, scratch))
+        atomic_store(&o->failed, 1);
+    if (atomic_fetch_sub(&o->chans_left, 1) != 1) return;
+
+    char path[BATCH_PATH_MAX];
+    output_path(path, sizeof(path), o->b->bo->output, o->f->name, o->b->book->v[o->preset].name);
+    make_parents(path);
+    int ok = !atomic_load(&o->failed) && render_write(in, path, o->x, o->gain);
+    arena_free_planes(NULL, o->x, in->wi.num_channels);
+    free(o->gain);
+    free(o->chans);
+    batch_done(o, ok, path);
+}
+
+static void batch_output(void *arg, Arena *scratch, Sched *s, int worker){
+    BatchOut *o = (BatchOut*)arg;
+    if (!batch_open(o->b, o->f)){ batch_done(o, 0, NULL); return; }
+    const RenderInput *in = &o->f->in;
+    uint16_t ch = in->wi.num_channels;
+    uint16_t w = render_split_width(ch, o->b->bo->threads);
+
+    if (!in->streaming && w < ch && in->nframes >= BATCH_SPLIT_FRAMES
+        && !render_uses_fixed(in, o->b->book, o->preset)){
+        int ntask = (ch + w - 1) / w;
+        o->x = arena_planes(NULL, ch, in->nframes);
+        o->gain = (float*)calloc(ch, sizeof(float));
+        o->chans = (BatchChan*)calloc((size_t)ntask, sizeof(BatchChan));
+        if (o->x && o->gain && o->chans){
+            atomic_store(&o->chans_left, ntask);
+            for (int t=0; t<ntask; t++){
+                uint16_t c0 = (uint16_t)(t * w);
+                o->chans[t] = (BatchChan){ o, c0, (uint16_t)(ch - c0 < w ? ch - c0 : w) };
+            }
+            /* the rest go on our own deque for idle workers to steal */
+            for (int t=ntask-1; t>0; t--)
+                if (!sched_push(s, worker, batch_channel, &o->chans[t]))
+                    batch_channel(&o->chans[t], scratch, s, worker);
+            batch_channel(&o->chans[0], scratch, s, worker);
+            return;
+        }
+        arena_free_planes(NULL, o->x, ch);
+        free(o->gain);
+        free(o->chans);
+    }
+
+    char path[BATCH_PATH_MAX];
+    output_path(path, sizeof(path), o->b->bo->output, o->f->name, o->b->book->v[o->preset].name);
+    make_parents(path);
+    batch_done(o, render_preset(in, o->b->book, o->preset, path, scratch), path);
+}
+
+static int add_file(Batch *b, int *cap, const char *path){
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)){
+        fprintf(stderr, "%s: %s\n", path, render_status_text(RENDER_ERR_OPEN));
+        return 1;
+    }
+    if (b->nfiles == *cap){
+        int n = *cap ? *cap * 2 : 256;
+        BatchFile *v = (BatchFile*)realloc(b->files, (size_t)n * sizeof(*v));
+        if (!v) return 0;
+        b->files = v;
+        *cap = n;
+    }
+    BatchFile *f = &b->files[b->nfiles];
+    memset(f, 0, sizeof(*f));
+    f->path = strdup(path);
+    if (!f->path) return 0;
+    f->size = st.st_size;
+    const char *base = strrchr(path, '/');
+    snprintf(f->name, sizeof(f->name), "%s", base ? base + 1 : path);
+    char *dot = strrchr(f->name, '.');
+    if (dot && dot != f->name) *dot = 0;
+    b->nfiles++;
+    return 1;
+}
+
+static int collect_files(Batch *b, const char *source){
+    int cap = 0;
+    struct stat st;
+    if (stat(source, &st) != 0) return 0;
+    if (S_ISDIR(st.st_mode)){
+        DIR *d = opendir(source);
+        if (!d) return 0;
+        struct dirent *e;
+        int ok = 1;
+        while (ok && (e = readdir(d))){
+            size_t n = strlen(e->d_name);
+            if (n < 5 || strcasecmp(e->d_name + n - 4, ".wav") != 0) continue;
+            char path[BATCH_PATH_MAX];
+            snprintf(path, sizeof(path), "%s/%s", source, e->d_name);
+            ok = add_file(b, &cap, path);
+        }
+        closedir(d);
+        return ok;
+    }
+    FILE *m = fopen(source, "r");
+    if (!m) return 0;
+    char *line = NULL;
+    size_t lcap = 0;
+    int ok = 1;
+    while (ok && getline(&line, &lcap, m) > 0){
+        size_t n = strlen(line);
+        while (n && (line[n-1] == '\n' || line[n-1] == '\r' || line[n-1] == ' ')) line[--n] = 0;
+        if (n && line[0] != '#') ok = add_file(b, &cap, line);
+    }
+    free(line);
+    fclose(m);
+    return ok;
+}
+
+/* smallest first: each worker works its deque from the back */
+static int by_size(const void *a, const void *b){
+    const BatchFile *x = (const BatchFile*)a, *y = (const BatchFile*)b;
+    if (x->size != y->size) return x->size < y->size ? -1 : 1;
+    return strcmp(x->path, y->path);
+}
+
+static int cmp_str(const void *a, const void *b){
+    return strcmp(*(char *const*)a, *(char *const*)b);
+}
+
+/* 1 when every file x preset expands to its own output path; files with
+   the same name in different directories would otherwise overwrite each
+   other while both are being written */
+static int outputs_unique(const Batch *b){
+    size_t n = (size_t)b->nfiles * b->bo->npresets, k = 0;
+    char **v = (char**)calloc(n ? n : 1, sizeof(char*));
+    int ok = v != NULL;
+    for (int i=0; ok && i<b->nfiles; i++)
+        for (int j=0; ok && j<b->bo->npresets; j++){
+            char path[BATCH_PATH_MAX];
+            output_path(path, sizeof(path), b->bo->output, b->files[i].name,
+                        b->book->v[b->bo->presets[j]].name);
+            ok = (v[k++] = strdup(path)) != NULL;
+        }
+    if (ok){
+        qsort(v, n, sizeof(char*), cmp_str);
+        for (size_t i=1; ok && i<n; i++)
+            if (strcmp(v[i-1], v[i]) == 0){
+                fprintf(stderr, "Bir nechta chiqish bir xil yo'lga yoziladi: %s\n", v[i]);
+                ok = 0;
+            }
+    } else fprintf(stderr, "Xotira ajratishda xatolik.\n");
+    for (size_t i=0; i<k; i++) free(v[i]);
+    free(v);
+    return ok;
+}
+
+int batch_run(const BatchOptions *bo, const PresetBook *book, const RenderOptions *opt){
+    Batch b;
+    memset(&b, 0, sizeof(b));
+    b.bo = bo;
+    b.book = book;
+    b.opt = *opt;
+    if (!collect_files(&b, bo->source)){
+        fprintf(stderr, "Ro'yxatni o'qishda xatolik: %s\n", bo->source);
+        for (int i=0; i<b.nfiles; i++) free(b.files[i].path);
+        free(b.files);
+        return 0;
+    }
+    if ((b.nfiles > 1 && !strstr(bo->output, "{name}")) || (bo->npresets > 1 && !strstr(bo->output, "{preset}"))){
+        fprintf(stderr, "Chiqish shablonida {name} va {preset} bo'lishi lozim: %s\n", bo->output);
+        for (int i=0; i<b.nfiles; i++) free(b.files[i].path);
+        free(b.files);
+        return 0;
+    }
+    if (!outputs_unique(&b)){
+        for (int i=0; i<b.nfiles; i++) free(b.files[i].path);
+        free(b.files);
+        return 0;
+    }
+    qsort(b.files, (size_t)b.nfiles, sizeof(BatchFile), by_size);
+
+    size_t nout = (size_t)b.nfiles * bo->npresets;
+    BatchOut *outs = (BatchOut*)calloc(nout ? nout : 1, sizeof(BatchOut));
+    Sched *s = sched_create(bo->threads, (size_t)16 << 20);
+    int ok = outs && s;
+    for (int i=0; i<b.nfiles; i++){
+        pthread_mutex_init(&b.files[i].mu, NULL);
+        atomic_store(&b.files[i].left, bo->npresets);
+    }
+    double t0 = now_sec();
+    for (int i=0; ok && i<b.nfiles; i++){
+        BatchFile *f = &b.files[i];
+        for (int k=0; k<bo->npresets; k++){
+            BatchOut *o = &outs[(size_t)i * bo->npresets + k];
+            o->b = &b;
+            o->f = f;
+            o->preset = bo->presets[k];
+            if (!sched_push(s, -1, batch_output, o)) ok = 0;
+        }
+    }
+    if (ok) ok = sched_run(s);
+    double wall = now_sec() - t0;
+
+    if (ok){
+        int bad_files = 0;
+        double seconds = 0.0;
+        for (int i=0; i<b.nfiles; i++){
+            if (b.files[i].state == 1) seconds += b.files[i].seconds;
+            else bad_files++;
+        }
+        if (wall <= 0.0) wall = 1e-9;
+        printf("Fayllar: %d (xato %d), chiqishlar: %d (xato %d)\n",
+               b.nfiles, bad_files, atomic_load(&b.ok), atomic_load(&b.bad));
+        printf("Vaqt: %.3f s | %.1f fayl/s | %.1f audio-s/s (presetlar bilan %.1f) | o'g'irlangan vazifalar: %llu\n",
+               wall, (b.nfiles - bad_files) / wall, seconds / wall, seconds * bo->npresets / wall,
+               (unsigned long long)sched_steals(s));
+        ok = bad_files == 0 && atomic_load(&b.bad) == 0;
+    } else {
+        fprintf(stderr, "Xotira ajratishda xatolik.\n");
+    }
+
+    sched_destroy(s);
+    for (int i=0; i<b.nfiles; i++){
+        free(b.files[i].path);
+        pthread_mutex_destroy(&b.files[i].mu);
+    }
+    free(b.files);
+    free(outs);
+    return ok;
+}
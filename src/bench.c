@@ -37,15 +37,6 @@ static void human_count(long x, char *buf, size_t n) {
     }
 }
 
-static void line(const char *title) {
-    const char *dashes = "------------------------------------------------------------";
-    int len = (int)strlen(title);
-    int w = 54;
-    int left = (w - len - 2); if (left < 0) left = 0;
-    int l = left/2, r = left - l;
-    fprintf(stderr, "%.*s %s %.*s\n", l, dashes, title, r, dashes);
-}
-
 static double now_wall(void) {
     struct timeval tv; gettimeofday(&tv, NULL);
     return (double)tv.tv_sec + (double)tv.tv_usec * 1e-6;
@@ -109,7 +100,7 @@ void bench_report_diff(const BenchSnapshot *a,
     human_count(d_vcsw,   vcsw_str,   sizeof vcsw_str);
     human_count(d_ivcsw,  ivcsw_str,  sizeof ivcsw_str);
 
-    line(label);
+    bench_banner(label);
 
     fprintf(stderr, "Time\n");
     fprintf(stderr, "  Wall             : %.6f s\n", wall);
@@ -125,8 +116,8 @@ void bench_report_diff(const BenchSnapshot *a,
     fprintf(stderr, "  Page faults      : minor %s | major %s\n", minflt_str, majflt_str);
     fprintf(stderr, "  Context switches : vol %s | invol %s\n", vcsw_str, ivcsw_str);
 
-    line("summary");
+    bench_banner("summary");
     fprintf(stderr, "wall %.3fs | CPU %.1f%% per-core | peak %s | faults %s/%s | ctx %s/%s\n",
             wall, util_per_core, peak_str, minflt_str, majflt_str, vcsw_str, ivcsw_str);
-    line("end");
+    bench_banner("end");
 }
@@ -0,0 +1,211 @@
+#include "biquad_multi.h"
+
+#if SIMD_VEC
+/* 4x4 transpose: four frames of four lanes <-> four lanes of four frames */
+static inline void transpose4(v4sf *r){
+    v4sf t0 = SIMD_SHUF(r[0], r[1], 0, 4, 1, 5), t1 = SIMD_SHUF(r[2], r[3], 0, 4, 1, 5);
+    v4sf t2 = SIMD_SHUF(r[0], r[1], 2, 6, 3, 7), t3 = SIMD_SHUF(r[2], r[3], 2, 6, 3, 7);
+    r[0] = SIMD_SHUF(t0, t1, 0, 1, 4, 5); r[1] = SIMD_SHUF(t0, t1, 2, 3, 6, 7);
+    r[2] = SIMD_SHUF(t2, t3, 0, 1, 4, 5); r[3] = SIMD_SHUF(t2, t3, 2, 3, 6, 7);
+}
+
+static inline v4sf flush_denormal4(v4sf v){
+    v4si m = (v > -DENORMAL_FLOOR) & (v < DENORMAL_FLOOR);
+    return (v4sf)((v4si)v & ~m);
+}
+
+/* up to four buffers, each through its own cascade q[l][0..nst-1]: every
+   SOS block is transposed into lanes once, all sections run on the tile
+   with their state in registers, then it is transposed back. Per lane the
+   arithmetic and the flush points are those of sos_process(). */
+static void sos_lanes(float *const *x, int lanes, uint32_t n, Biquad *(*q)[SOS_MAX_STAGES], int nst){
+    v4sf b0[nst], b1[nst], b2[nst], a1[nst], a2[nst], z1[nst], z2[nst];
+    for (int j=0;j<nst;j++){
+        b0[j] = b1[j] = b2[j] = a1[j] = a2[j] = z1[j] = z2[j] = (v4sf){0};
+        for (int l=0;l<lanes;l++){
+            const Biquad *p = q[l][j];
+            b0[j][l]=p->b0; b1[j][l]=p->b1; b2[j][l]=p->b2; a1[j][l]=p->a1; a2[j][l]=p->a2;
+            z1[j][l]=p->z1; z2[j][l]=p->z2;
+        }
+    }
+    /* missing lanes read and write a zero pad; their filters are all zero */
+    float pad[SOS_BLOCK] = {0};
+    v4sf tile[SOS_BLOCK];
+    for (uint32_t off=0; off<n; off+=SOS_BLOCK){
+        uint32_t cnt = (n - off < SOS_BLOCK) ? n - off : SOS_BLOCK;
+        float *p[SIMD_LANES];
+        for (int l=0;l<SIMD_LANES;l++) p[l] = l < lanes ? x[l] + off : pad;
+        uint32_t i = 0;
+        for (; i+4<=cnt; i+=4){
+            for (int l=0;l<SIMD_LANES;l++) memcpy(&tile[i+l], p[l] + i, 16);
+            transpose4(&tile[i]);
+        }
+        for (; i<cnt; i++)
+            for (int l=0;l<SIMD_LANES;l++) tile[i][l] = p[l][i];
+
+        /* sections in pairs: the second one's recursion overlaps the first's */
+        int j = 0;
+        for (; j+2<=nst; j+=2){
+            v4sf c0 = b0[j], c1 = b1[j], c2 = b2[j], d1 = a1[j], d2 = a2[j], s1 = z1[j], s2 = z2[j];
+            v4sf e0 = b0[j+1], e1 = b1[j+1], e2 = b2[j+1], f1 = a1[j+1], f2 = a2[j+1];
+            v4sf t1 = z1[j+1], t2 = z2[j+1];
+            for (i=0;i<cnt;i++){
+                v4sf in = tile[i];
+                v4sf mid = c0*in + s1;
+                s1 = c1*in + s2 - d1*mid;
+                s2 = c2*in - d2*mid;
+                v4sf out = e0*mid + t1;
+                t1 = e1*mid + t2 - f1*out;
+                t2 = e2*mid - f2*out;
+                tile[i] = out;
+            }
+            z1[j] = flush_denormal4(s1); z2[j] = flush_denormal4(s2);
+            z1[j+1] = flush_denormal4(t1); z2[j+1] = flush_denormal4(t2);
+        }
+        if (j < nst){
+            v4sf c0 = b0[j], c1 = b1[j], c2 = b2[j], d1 = a1[j], d2 = a2[j], s1 = z1[j], s2 = z2[j];
+            for (i=0;i<cnt;i++){
+                v4sf in = tile[i];
+                v4sf out = c0*in + s1;
+                s1 = c1*in + s2 - d1*out;
+                s2 = c2*in - d2*out;
+                tile[i] = out;
+            }
+            z1[j] = flush_denormal4(s1); z2[j] = flush_denormal4(s2);
+        }
+
+        for (i=0; i+4<=cnt; i+=4){
+            transpose4(&tile[i]);
+            for (int l=0;l<lanes;l++) memcpy(p[l] + i, &tile[i+l], 16);
+        }
+        for (; i<cnt; i++)
+            for (int l=0;l<lanes;l++) p[l][i] = tile[i][l];
+    }
+    for (int j=0;j<nst;j++)
+        for (int l=0;l<lanes;l++){ q[l][j]->z1 = z1[j][l]; q[l][j]->z2 = z2[j][l]; }
+}
+#endif
+
+void biquad_process_multi(float *const *x, uint32_t n, Biquad *const *q, int count){
+#if SIMD_VEC
+    for (int g=0; g<count; g+=SIMD_LANES){
+        int lanes = (count - g < SIMD_LANES) ? count - g : SIMD_LANES;
+        if (lanes == 1){ biquad_process_inplace(x[g], n, q[g]); continue; }
+        Biquad *lq[SIMD_LANES][SOS_MAX_STAGES];
+        for (int l=0;l<lanes;l++) lq[l][0] = q[g+l];
+        sos_lanes(x + g, lanes, n, lq, 1);
+    }
+#else
+    for (int k=0;k<count;k++) biquad_process_inplace(x[k], n, q[k]);
+#endif
+}
+
+void sos_process_multi(float *const *x, uint32_t n, Sos *const *s, int count){
+    for (int g=0; g<count; g+=SIMD_LANES){
+        int lanes = (count - g < SIMD_LANES) ? count - g : SIMD_LANES;
+        int nst = s[g]->nstages, same = 1;
+        for (int l=1;l<lanes;l++) same &= s[g+l]->nstages == nst;
+#if SIMD_VEC
+        if (lanes > 1 && same && nst > 0){
+            Biquad *lq[SIMD_LANES][SOS_MAX_STAGES];
+            for (int l=0;l<lanes;l++)
+                for (int j=0;j<nst;j++) lq[l][j] = &s[g+l]->st[j];
+            sos_lanes(x + g, lanes, n, lq, nst);
+            continue;
+        }
+#endif
+        for (int l=0;l<lanes;l++) sos_process(s[g+l], x[g+l], n);
+    }
+}
+
+void biquad_block4_init(BiquadBlock4 *b, const Biquad *q){
+    double a1 = q->a1, a2 = q->a2, b0 = q->b0;
+    double B[2] = { q->b1 - a1*b0, q->b2 - a2*b0 };
+    double h[4];
+    double r[2] = { 1.0, 0.0 };         /* C*A^k */
+    double v[2] = { B[0], B[1] };       /* A^k*B */
+    double AkB[4][2];
+    h[0] = b0;
+    for (int k=0;k<4;k++){
+        b->o1[k] = (float)r[0]; b->o2[k] = (float)r[1];
+        if (k < 3) h[k+1] = r[0]*B[0] + r[1]*B[1];
+        double r0 = -a1*r[0] - a2*r[1];
+        r[1] = r[0]; r[0] = r0;
+        AkB[k][0] = v[0]; AkB[k][1] = v[1];
+        double v0 = -a1*v[0] + v[1];
+        v[1] = -a2*v[0]; v[0] = v0;
+    }
+    for (int j=0;j<4;j++)
+        for (int k=0;k<4;k++) b->t[j][k] = (k >= j) ? (float)h[k-j] : 0.0f;
+    for (int j=0;j<4;j++){ b->p1[j] = (float)AkB[3-j][0]; b->p2[j] = (float)AkB[3-j][1]; }
+
+    double A[2][2] = { { -a1, 1.0 }, { -a2, 0.0 } }, M[2][2] = { { 1.0, 0.0 }, { 0.0, 1.0 } };
+    for (int k=0;k<4;k++){
+        double T[2][2];
+        for (int i=0;i<2;i++)
+            for (int j=0;j<2;j++) T[i][j] = M[i][0]*A[0][j] + M[i][1]*A[1][j];
+        memcpy(M, T, sizeof(M));
+    }
+    for (int i=0;i<2;i++)
+        for (int j=0;j<2;j++) b->a4[i][j] = (float)M[i][j];
+
+    b->b0 = q->b0; b->b1 = q->b1; b->b2 = q->b2; b->a1 = q->a1; b->a2 = q->a2;
+    b->z1 = q->z1; b->z2 = q->z2;
+}
+
+void biquad_block4_process(BiquadBlock4 *b, float *x, uint32_t n){
+    float z1 = b->z1, z2 = b->z2;
+    uint32_t i = 0;
+#if SIMD_VEC
+    v4sf o1, o2, t0, t1, t2, t3, p1, p2;
+    memcpy(&o1, b->o1, 16); memcpy(&o2, b->o2, 16);
+    memcpy(&t0, b->t[0], 16); memcpy(&t1, b->t[1], 16);
+    memcpy(&t2, b->t[2], 16); memcpy(&t3, b->t[3], 16);
+    memcpy(&p1, b->p1, 16); memcpy(&p2, b->p2, 16);
+    for (; i+4<=n; i+=4){
+        v4sf u; memcpy(&u, x+i, 16);
+        v4sf y = o1*z1 + o2*z2 + t0*u[0] + t1*u[1] + t2*u[2] + t3*u[3];
+        v4sf s1 = p1*u, s2 = p2*u;
+        float nz1 = b->a4[0][0]*z1 + b->a4[0][1]*z2 + ((s1[0] + s1[1]) + (s1[2] + s1[3]));
+        float nz2 = b->a4[1][0]*z1 + b->a4[1][1]*z2 + ((s2[0] + s2[1]) + (s2[2] + s2[3]));
+        z1 = nz1; z2 = nz2;
+        memcpy(x+i, &y, 16);
+        if ((i + 4) % SOS_BLOCK == 0){ z1 = flush_denormal(z1); z2 = flush_denormal(z2); }
+    }
+#else
+    for (; i+4<=n; i+=4){
+        float y[4], s1 = 0.0f, s2 = 0.0f;
+        for (int k=0;k<4;k++){
+            y[k] = b->o1[k]*z1 + b->o2[k]*z2;
+            for (int j=0;j<4;j++) y[k] += b->t[j][k]*x[i+j];
+        }
+        for (int j=0;j<4;j++){ s1 += b->p1[j]*x[i+j]; s2 += b->p2[j]*x[i+j]; }
+        float nz1 = b->a4[0][0]*z1 + b->a4[0][1]*z2 + s1;
+        float nz2 = b->a4[1][0]*z1 + b->a4[1][1]*z2 + s2;
+        z1 = nz1; z2 = nz2;
+        memcpy(x+i, y, sizeof(y));
+        if ((i + 4) % SOS_BLOCK == 0){ z1 = flush_denormal(z1); z2 = flush_denormal(z2); }
+    }
+#endif
+    for (; i<n; i++){
+        float in = x[i];
+        float out = b->b0*in + z1;
+        z1 = b->b1*in + z2 - b->a1*out;
+        z2 = b->b2*in - b->a2*out;
+        x[i] = out;
+    }
+    b->z1 = flush_denormal(z1); b->z2 = flush_denormal(z2);
+}
+
+void biquad_block4_store(const BiquadBlock4 *b, Biquad *q){
+    q->z1 = b->z1; q->z2 = b->z2;
+}
+
+void sos_process_block4(Sos *s, BiquadBlock4 *b, float *x, uint32_t n){
+    for (int k=0;k<s->nstages;k++){ b[k].z1 = s->st[k].z1; b[k].z2 = s->st[k].z2; }
+    for (uint32_t off=0; off<n; off+=SOS_BLOCK){
+        uint32_t cnt = (n - off < SOS_BLOCK) ? n - off : SOS_BLOCK;
+        for (int k=0;k<s->nstages;k++) biquad_block4_process(&b[k], x+off, cnt);
+    }
+    for (int k=0;k<s->nstages;k++) biquad_block4_store(&b[k], &s->st[k]);
+}
@@ -0,0 +1,588 @@
+#include "chain.h"
+
+static int is_head(StageKind k){
+    return k==ST_RESAMPLE || k==ST_PITCH;
+}
+
+static int needs_analysis(StageKind k){
+    return k==ST_PEAK_NORM || k==ST_RMS_NORM || k==ST_NOISE;
+}
+
+static int is_normalize(StageKind k){
+    return k==ST_PEAK_NORM || k==ST_RMS_NORM;
+}
+
+/* commutes with a positive scalar gain */
+static int is_linear(StageKind k){
+    return k==ST_SOS || k==ST_GAIN || k==ST_REVERB || k==ST_RING_MOD || k==ST_TREMOLO;
+}
+
+static int is_barrier(const FxChain *c, int i){
+    return needs_analysis(c->st[i].kind) && c->st[i].defer != DEFER_FOLD;
+}
+
+static int is_pointwise(StageKind k){
+    switch (k){
+        case ST_GAIN: case ST_PEAK_NORM: case ST_RMS_NORM: case ST_TANH: case ST_RING_MOD:
+        case ST_TREMOLO: case ST_BITCRUSH: case ST_NOISE: case ST_CLIP:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+#if PROFILE
+static const char *stage_names[] = {
+    "resample", "pitch", "sos", "gain", "peak_norm", "rms_norm", "tanh", "ring_mod",
+    "tremolo", "bitcrush", "noise", "clip", "reverb"
+};
+
+/* bytes per sample: read and written in place, plus delay line traffic */
+static uint64_t stage_bytes(const Stage *s, const StageState *t){
+    uint64_t b = 8;
+    if (s->kind == ST_REVERB){
+        if (t->rv.has_early) b += 4 * (uint64_t)(t->rv.early.ntaps + 1);
+        if (t->rv.has_fdn) b += 8 * FDN_LINES;
+    }
+    return b;
+}
+
+/* rows follow the plan: a fused run is one row, its ops joined by '+' */
+static int chain_prof_setup(FxChain *c){
+    char buf[256];
+    size_t n = 0;
+    c->prof_name = prof_intern(c->name);
+    buf[0] = 0;
+    for (int i=0; i<c->nhead && n < sizeof(buf); i++)
+        n += (size_t)snprintf(buf + n, sizeof(buf) - n, "%s%s", i ? "+" : "", stage_names[c->st[i].kind]);
+    c->prof_head_name = prof_intern(c->nhead ? buf : "source");
+    c->prof_tail_name = prof_intern("tail gain");
+    if (!c->prof_head) c->prof_head = (ProfStat*)calloc(1, sizeof(ProfStat));
+    if (!c->prof_tail) c->prof_tail = (ProfStat*)calloc(c->nch, sizeof(ProfStat));
+    if (!c->prof_head || !c->prof_tail) return 0;
+    for (int i=c->nhead; i<c->nst; i++){
+        Stage *s = &c->st[i];
+        int end = s->fuse_end > i ? s->fuse_end : i + 1;
+        n = 0;
+        buf[0] = 0;
+        for (int k=i; k<end && n < sizeof(buf); k++)
+            n += (size_t)snprintf(buf + n, sizeof(buf) - n, "%s%s", k > i ? "+" : "", stage_names[c->st[k].kind]);
+        s->prof_name = prof_intern(buf);
+        snprintf(buf, sizeof(buf), "%s analyze", stage_names[s->kind]);
+        s->prof_an_name = prof_intern(buf);
+        if (!s->prof) s->prof = (ProfStat*)calloc(c->nch + 1, sizeof(ProfStat));
+        if (!s->prof_an) s->prof_an = (ProfStat*)calloc(c->nch, sizeof(ProfStat));
+        if (!s->prof || !s->prof_an) return 0;
+    }
+    return 1;
+}
+
+static void chain_prof_flush(FxChain *c){
+    if (c->prof_head) prof_add(c->prof_name, -1, c->prof_head_name, PROF_ALL_CH, c->prof_head);
+    for (int i=c->nhead; i<c->nst; i++){
+        Stage *s = &c->st[i];
+        for (uint16_t ch=0; ch<=c->nch; ch++){
+            int id = ch < c->nch ? c->ch0 + ch : PROF_ALL_CH;
+            if (s->prof_an && ch < c->nch) prof_add(c->prof_name, i, s->prof_an_name, id, &s->prof_an[ch]);
+            if (s->prof) prof_add(c->prof_name, i, s->prof_name, id, &s->prof[ch]);
+        }
+        free(s->prof);
+        free(s->prof_an);
+    }
+    for (uint16_t ch=0; c->prof_tail && ch<c->nch; ch++)
+        prof_add(c->prof_name, c->nst, c->prof_tail_name, c->ch0 + ch, &c->prof_tail[ch]);
+    free(c->prof_head);
+    free(c->prof_tail);
+}
+#endif
+
+int chain_init(FxChain *c, float sr, uint16_t nch, Arena *mem){
+    memset(c,0,sizeof(*c));
+    c->sr = sr;
+    c->nch = nch ? nch : 1;
+    c->tail = -1;
+    c->mem = mem;
+    return 1;
+}
+
+void chain_free(FxChain *c){
+#if PROFILE
+    chain_prof_flush(c);
+#endif
+    for (int i=0;i<c->nst;i++){
+        Stage *s = &c->st[i];
+        if (s->kind == ST_RESAMPLE) poly_resampler_free(&s->rs);
+        if (s->kind == ST_PITCH) pitch_source_free(&s->ps);
+        if (s->ch) for (uint16_t ch=0; ch<c->nch; ch++) reverb_free(&s->ch[ch].rv);
+        arena_free(c->mem, s->b4);
+        arena_free(c->mem, s->ch);
+    }
+    arena_free(c->mem, c->st);
+    arena_free_planes(c->mem, c->scratch, c->nch);
+    memset(c,0,sizeof(*c));
+}
+
+void chain_set_seed(FxChain *c, uint32_t seed, uint16_t first_channel){
+    c->seed = seed;
+    c->ch0 = first_channel;
+}
+
+void chain_set_name(FxChain *c, const char *name){
+    c->name = name;
+}
+
+void chain_set_tanh_mode(FxChain *c, TanhMode mode){
+    for (int i=0;i<c->nst;i++)
+        if (c->st[i].kind == ST_TANH) c->st[i].b = (float)mode;
+}
+
+int chain_set_filter_mode(FxChain *c, FilterMode mode){
+    for (int i=0;i<c->nst;i++){
+        Stage *s = &c->st[i];
+        if (s->kind != ST_SOS) continue;
+        arena_free(c->mem, s->b4);
+        s->b4 = NULL;
+        if (mode != FILTER_BLOCK4 || c->nch != 1) continue;
+        s->b4 = (BiquadBlock4*)arena_alloc(c->mem, sizeof(BiquadBlock4) * s->coef.nstages);
+        if (!s->b4) return 0;
+        for (int k=0;k<s->coef.nstages;k++) biquad_block4_init(&s->b4[k], &s->coef.st[k]);
+    }
+    return 1;
+}
+
+static Stage* chain_push(FxChain *c, StageKind kind, float a, float b){
+    if (is_head(kind) && c->nhead != c->nst) return NULL;
+    if (c->nst == c->cap){
+        int cap = c->cap ? c->cap*2 : 8;
+        Stage *st = (Stage*)arena_alloc(c->mem, sizeof(Stage)*cap);
+        if (!st) return NULL;
+        if (c->nst) memcpy(st, c->st, sizeof(Stage)*c->nst);
+        arena_free(c->mem, c->st);
+        c->st = st; c->cap = cap;
+    }
+    Stage *s = &c->st[c->nst];
+    memset(s,0,sizeof(*s));
+    s->ch = (StageState*)arena_calloc(c->mem, c->nch, sizeof(StageState));
+    if (!s->ch) return NULL;
+    s->kind = kind; s->a = a; s->b = b;
+    c->nst++;
+    if (is_head(kind)) c->nhead++;
+    return s;
+}
+
+int chain_add(FxChain *c, StageKind kind, float a, float b){
+    Stage *s = chain_push(c, kind, a, b);
+    if (!s) return 0;
+    switch (kind){
+        case ST_RING_MOD:
+        case ST_TREMOLO:
+            for (uint16_t ch=0; ch<c->nch; ch++) osc_init(&s->ch[ch].lfo, c->sr, a, 0.0f);
+            break;
+        default: break;
+    }
+    return 1;
+}
+
+int chain_add_biquad(FxChain *c, Biquad q){
+    q.z1 = q.z2 = 0.0f;
+    if (c->nst > c->nhead){
+        Stage *last = &c->st[c->nst-1];
+        if (last->kind == ST_SOS && sos_add(&last->coef, q)) return 1;
+    }
+    Stage *s = chain_push(c, ST_SOS, 0.0f, 0.0f);
+    if (!s) return 0;
+    sos_init(&s->coef);
+    return sos_add(&s->coef, q);
+}
+
+static int chain_add_sos(FxChain *c, const Sos *s){
+    for (int k=0;k<s->nstages;k++)
+        if (!chain_add_biquad(c, s->st[k])) return 0;
+    return 1;
+}
+
+int chain_add_bandlimit(FxChain *c, float f_lo, float f_hi){
+    Sos s; sos_init(&s);
+    return sos_bandlimit(&s, c->sr, f_lo, f_hi) && chain_add_sos(c, &s);
+}
+
+int chain_add_bandpass_boost(FxChain *c, float f_center, float q, float gain_db){
+    Sos s; sos_init(&s);
+    return sos_bandpass_boost(&s, c->sr, f_center, q, gain_db) && chain_add_sos(c, &s);
+}
+
+int chain_add_reverb(FxChain *c, const ReverbParams *p){
+    Stage *s = chain_push(c, ST_REVERB, 0.0f, 0.0f);
+    if (!s) return 0;
+    for (uint16_t ch=0; ch<c->nch; ch++)
+        if (!reverb_init(&s->ch[ch].rv, c->sr, p, c->mem)) return 0;
+    return 1;
+}
+
+uint32_t chain_latency(const FxChain *c){
+    uint32_t lat = 0;
+    for (int i=0;i<c->nhead;i++)
+        if (c->st[i].kind == ST_PITCH) lat += pitch_shifter_latency(c->sr, c->st[i].a);
+    return lat;
+}
+
+static void stage_reset(Stage *s, StageState *t, uint32_t seed){
+    t->sos = s->coef;
+    if (s->defer == DEFER_FOLD) t->gain = 1.0f;
+    if (s->kind == ST_RING_MOD || s->kind == ST_TREMOLO) osc_reset(&t->lfo);
+    if (s->kind == ST_NOISE) rng_seed(&t->rng, seed);
+    reverb_reset(&t->rv);
+}
+
+static void stage_begin_analysis(StageState *t){
+    t->peak = 1e-9f;
+    t->acc = 0.0;
+}
+
+static void stage_analyze(Stage *s, StageState *t, const float *x, uint32_t n){
+    if (s->kind == ST_PEAK_NORM) t->peak = peak_abs(x, n, t->peak);
+    else t->acc = sum_squares(x, n, t->acc);
+}
+
+static void stage_analyze_all(FxChain *c, Stage *s, float **x, uint32_t n){
+    for (uint16_t ch=0; ch<c->nch; ch++){
+        PROF_BEGIN(pm);
+        stage_analyze(s, &s->ch[ch], x[ch], n);
+        PROF_END(pm, &s->prof_an[ch], n, (uint64_t)4 * n, s->prof_an_name, c->prof_name, c->ch0 + ch);
+    }
+}
+
+static void stage_resolve(Stage *s, StageState *t, uint64_t n){
+    switch (s->kind){
+        case ST_PEAK_NORM:
+            t->gain = db_to_lin(s->a) / t->peak; break;
+        case ST_RMS_NORM: {
+            float rms = n ? sqrtf((float)(t->acc/(double)n)) : 0.0f;
+            t->gain = (rms < 1e-9f) ? 1.0f : db_to_lin(s->a) / rms;
+        } break;
+        case ST_NOISE: {
+            float sig_pow = n ? (float)(t->acc/(double)n) : 0.0f;
+            float noise_pow = sig_pow / powf(10.0f, s->a/10.0f);
+            t->gain = sqrtf(fmaxf(1e-12f, noise_pow));
+        } break;
+        default: break;
+    }
+}
+
+static void stage_process(Stage *s, StageState *t, float *x, uint32_t n){
+    switch (s->kind){
+        case ST_RESAMPLE:
+        case ST_PITCH:     break;
+        case ST_SOS:       sos_process(&t->sos, x, n); break;
+        case ST_GAIN:      apply_gain(x, n, s->a); break;
+        case ST_PEAK_NORM:
+        case ST_RMS_NORM:
+            if (s->defer == DEFER_NONE && t->gain != 1.0f) apply_gain(x, n, t->gain);
+            break;
+        case ST_TANH:
+            if (s->b == (float)TANH_FAST) soft_limiter_tanh_fast(x, n, s->a);
+            else soft_limiter_tanh(x, n, s->a);
+            break;
+        case ST_RING_MOD:  ring_mod_block(x, n, &t->lfo, s->b); break;
+        case ST_TREMOLO:   tremolo_block(x, n, &t->lfo, s->b); break;
+        case ST_BITCRUSH:  bitcrush(x, n, (int)s->a); break;
+        case ST_NOISE:     add_white_noise_std(x, n, t->gain, &t->rng); break;
+        case ST_CLIP:      clip_safe(x, n); break;
+        case ST_REVERB:    reverb_process(&t->rv, x, n); break;
+    }
+}
+
+/* returns 0 when the stage is an identity for this block */
+static int stage_fused_op(Stage *s, StageState *t, FusedOp *op){
+    memset(op,0,sizeof(*op));
+    op->a = s->a;
+    switch (s->kind){
+        case ST_GAIN:      op->kind = FOP_GAIN; break;
+        case ST_PEAK_NORM:
+        case ST_RMS_NORM:
+            if (s->defer != DEFER_NONE || t->gain == 1.0f) return 0;
+            op->kind = FOP_GAIN; op->a = t->gain; break;
+        case ST_TANH:      op->kind = s->b == (float)TANH_FAST ? FOP_TANH_FAST : FOP_TANH; break;
+        case ST_BITCRUSH:  op->kind = FOP_BITCRUSH; break;
+        case ST_CLIP:      op->kind = FOP_CLIP; break;
+        case ST_RING_MOD:  op->kind = FOP_RING_MOD; op->a = s->b; op->lfo = &t->lfo; break;
+        case ST_TREMOLO:   op->kind = FOP_TREMOLO; op->a = s->b; op->lfo = &t->lfo; break;
+        case ST_NOISE:     op->kind = FOP_NOISE; op->a = t->gain; op->rng = &t->rng; break;
+        default:           return 0;
+    }
+    return 1;
+}
+
+static void stage_process_fused(FxChain *c, int lo, int hi, float **x, uint32_t n){
+    for (uint16_t ch=0; ch<c->nch; ch++){
+        FusedOp ops[FUSED_MAX_OPS];
+        int nops = 0;
+        for (int i=lo; i<hi; i++)
+            nops += stage_fused_op(&c->st[i], &c->st[i].ch[ch], &ops[nops]);
+        if (!nops) continue;
+        PROF_BEGIN(pm);
+        fused_process(ops, nops, x[ch], n);
+        PROF_END(pm, &c->st[lo].prof[ch], n, (uint64_t)8 * n, c->st[lo].prof_name, c->prof_name, c->ch0 + ch);
+    }
+}
+
+/* all channels of one stage; a cascade runs over all channels in lanes,
+   or through the block form on a mono chain that asked for it */
+static void stage_process_all(FxChain *c, Stage *s, float **x, uint32_t n){
+    if (is_normalize(s->kind) && s->defer != DEFER_NONE) return;
+    if (s->kind == ST_SOS && c->nch > 1){
+        Sos *q[c->nch];
+        for (uint16_t ch=0; ch<c->nch; ch++) q[ch] = &s->ch[ch].sos;
+        PROF_BEGIN(pm);
+        sos_process_multi(x, n, q, c->nch);
+        PROF_END(pm, &s->prof[c->nch], n * c->nch, (uint64_t)8 * n * c->nch, s->prof_name, c->prof_name,
+                 PROF_ALL_CH);
+        return;
+    }
+    if (s->b4){
+        PROF_BEGIN(pm);
+        sos_process_block4(&s->ch[0].sos, s->b4, x[0], n);
+        PROF_END(pm, &s->prof[0], n, (uint64_t)8 * n, s->prof_name, c->prof_name, c->ch0);
+        return;
+    }
+    for (uint16_t ch=0; ch<c->nch; ch++){
+        PROF_BEGIN(pm);
+        stage_process(s, &s->ch[ch], x[ch], n);
+        PROF_END(pm, &s->prof[ch], n, stage_bytes(s, &s->ch[ch]) * n, s->prof_name, c->prof_name, c->ch0 + ch);
+    }
+}
+
+static void chain_plan(FxChain *c){
+    c->tail = -1;
+    for (int i=c->nhead; i<c->nst; i++){
+        Stage *s = &c->st[i];
+        s->defer = DEFER_NONE;
+        if (!is_normalize(s->kind)) continue;
+        int j = i + 1;
+        while (j < c->nst && is_linear(c->st[j].kind)) j++;
+        if (j == c->nst){ s->defer = DEFER_TAIL; c->tail = i; }
+        else if (is_normalize(c->st[j].kind)) s->defer = DEFER_FOLD;
+    }
+    for (int i=c->nhead; i<c->nst; ){
+        int j = i + 1;
+        if (is_pointwise(c->st[i].kind))
+            while (j < c->nst && j - i < FUSED_MAX_OPS && is_pointwise(c->st[j].kind)
+                   && !is_barrier(c, j)) j++;
+        c->st[i].fuse_end = j;
+        i = j;
+    }
+}
+
+/* stages [lo, hi) in plan order; hi is the end of the chain or a
+   whole-signal stage, so it never splits a fused run */
+static void chain_run_stages(FxChain *c, int lo, int hi, float **x, uint32_t n){
+    for (int i=lo; i<hi; ){
+        int end = c->st[i].fuse_end;
+        if (end > i + 1) stage_process_fused(c, i, end, x, n);
+        else stage_process_all(c, &c->st[i], x, n);
+        i = end > i ? end : i + 1;
+    }
+}
+
+static int chain_bind(FxChain *c, FxSource *src, uint32_t block){
+    c->src = src;
+    c->head = src;
+    c->n = src->length;
+    c->block = block;
+    chain_plan(c);
+#if PROFILE
+    if (!chain_prof_setup(c)) return 0;
+#endif
+    for (int i=0;i<c->nhead;i++){
+        Stage *s = &c->st[i];
+        if (s->kind == ST_PITCH){
+            pitch_source_free(&s->ps);
+            if (!pitch_source_init(&s->ps, c->head, c->sr, s->a, block, c->mem)) return 0;
+            c->head = &s->ps.base;
+        } else {
+            poly_resampler_free(&s->rs);
+            if (!poly_resampler_init(&s->rs, c->head, s->a, (ResampleQuality)(int)s->b, block,
+                                     c->mem)) return 0;
+            c->head = &s->rs.base;
+        }
+    }
+    return 1;
+}
+
+static void chain_rewind(FxChain *c){
+    for (int i=0;i<c->nst;i++)
+        for (uint16_t ch=0; ch<c->nch; ch++)
+            stage_reset(&c->st[i], &c->st[i].ch[ch], seed_mix(seed_mix(c->seed, c->ch0 + ch), (uint32_t)i));
+    c->head->rewind(c->head);
+    c->pos = 0;
+}
+
+static uint32_t head_pull(FxChain *c, float **out, uint32_t count){
+    uint32_t left = c->n - c->pos;
+    if (count > left) count = left;
+    uint32_t got = 0;
+    PROF_BEGIN(pm);
+    while (got < count){
+        float *dst[c->nch];
+        for (uint16_t ch=0; ch<c->nch; ch++) dst[ch] = out[ch] + got;
+        uint32_t r = c->head->read(c->head, dst, count - got);
+        if (!r) break;
+        got += r;
+    }
+    PROF_END(pm, c->prof_head, got * c->nch, (uint64_t)8 * got * c->nch, c->prof_head_name, c->prof_name,
+             PROF_ALL_CH);
+    for (uint16_t ch=0; ch<c->nch; ch++)
+        if (got < count) memset(out[ch] + got, 0, sizeof(float)*(count - got));
+    c->pos += count;
+    return count;
+}
+
+static uint32_t chain_run(FxChain *c, float **out, uint32_t count, int upto){
+    uint32_t n = head_pull(c, out, count);
+    if (!n) return 0;
+    chain_run_stages(c, c->nhead, upto, out, n);
+    return n;
+}
+
+/* Whole-signal mode runs tile by tile: every stage up to the next barrier
+   (a stage that needs a statistic of the whole signal) goes over one small
+   tile of all channels before the next tile is touched, so the signal is
+   traversed once per barrier rather than once per stage. */
+#define CHAIN_TILE 2048
+
+static void chain_tail_gain(const FxChain *c, float *gain){
+    for (uint16_t ch=0; ch<c->nch; ch++)
+        gain[ch] = c->tail >= 0 ? c->st[c->tail].ch[ch].gain : 1.0f;
+}
+
+static void chain_apply_tail(FxChain *c, float **x, uint32_t n){
+    if (c->tail < 0) return;
+    float gain[c->nch];
+    chain_tail_gain(c, gain);
+    for (uint16_t ch=0; ch<c->nch; ch++){
+        if (gain[ch] == 1.0f) continue;
+        PROF_BEGIN(pm);
+        apply_gain(x[ch], n, gain[ch]);
+        PROF_END(pm, &c->prof_tail[ch], n, (uint64_t)8 * n, c->prof_tail_name, c->prof_name, c->ch0 + ch);
+    }
+}
+
+int chain_process_buffer(FxChain *c, float **x, uint32_t n){
+    float gain[c->nch];
+    if (!chain_process_buffer_gain(c, x, n, gain)) return 0;
+    chain_apply_tail(c, x, n);
+    return 1;
+}
+
+int chain_process_buffer_gain(FxChain *c, float **x, uint32_t n, float *gain){
+    float **tmp = NULL;
+    MemSource ms;
+    if (c->nhead){
+        tmp = arena_planes(c->mem, c->nch, n);
+        if (!tmp) return 0;
+        for (uint16_t ch=0; ch<c->nch; ch++) memcpy(tmp[ch], x[ch], sizeof(float)*n);
+        mem_source_init(&ms, tmp, n, c->nch);
+    } else {
+        mem_source_init(&ms, x, n, c->nch);
+    }
+    if (!chain_bind(c, &ms.base, CHAIN_TILE)) goto fail;
+    chain_rewind(c);
+
+    /* each segment ends at a barrier, whose statistic is taken from the
+       tiles as they leave the segment */
+    int lo = c->nhead, pulled = 0;
+    while (!pulled || lo < c->nst){
+        int hi = lo;
+        if (pulled){
+            for (uint16_t ch=0; ch<c->nch; ch++) stage_resolve(&c->st[lo], &c->st[lo].ch[ch], n);
+            hi++;
+        }
+        while (hi < c->nst && !is_barrier(c, hi)) hi++;
+        Stage *next = hi < c->nst ? &c->st[hi] : NULL;
+        if (next) for (uint16_t ch=0; ch<c->nch; ch++) stage_begin_analysis(&next->ch[ch]);
+        for (uint32_t off=0; off<n; off+=CHAIN_TILE){
+            uint32_t m = n - off < CHAIN_TILE ? n - off : CHAIN_TILE;
+            float *t[c->nch];
+            for (uint16_t ch=0; ch<c->nch; ch++) t[ch] = x[ch] + off;
+            if (!pulled && c->nhead) head_pull(c, t, m);
+            chain_run_stages(c, lo, hi, t, m);
+            if (next) stage_analyze_all(c, next, t, m);
+        }
+        pulled = 1;
+        lo = hi;
+    }
+    chain_tail_gain(c, gain);
+    arena_free_planes(c->mem, tmp, c->nch);
+    return 1;
+fail:
+    arena_free_planes(c->mem, tmp, c->nch);
+    return 0;
+}
+
+int chain_prepare(FxChain *c, FxSource *src, uint32_t block){
+    if (!block) block = 4096;
+    if (src->nch != c->nch) return 0;
+    if (!chain_bind(c, src, block)) return 0;
+    c->scratch = arena_planes(c->mem, c->nch, block);
+    if (!c->scratch) return 0;
+
+    for (int b=c->nhead; b<c->nst; b++){
+        Stage *s = &c->st[b];
+        if (!is_barrier(c, b)) continue;
+        chain_rewind(c);
+        for (uint16_t ch=0; ch<c->nch; ch++) stage_begin_analysis(&s->ch[ch]);
+        uint32_t got;
+        while ((got = chain_run(c, c->scratch, block, b)) > 0) stage_analyze_all(c, s, c->scratch, got);
+        for (uint16_t ch=0; ch<c->nch; ch++) stage_resolve(s, &s->ch[ch], c->n);
+    }
+    chain_rewind(c);
+    return 1;
+}
+
+int chain_start_live(FxChain *c, uint32_t block){
+    for (int i=0;i<c->nhead;i++)
+        if (c->st[i].kind == ST_RESAMPLE) return 0;
+    mem_source_init(&c->feed, NULL, 0, c->nch);
+    if (!block || !chain_bind(c, &c->feed.base, block)) return 0;
+    for (int i=0;i<c->nhead;i++) pitch_source_set_live(&c->st[i].ps);
+    chain_rewind(c);
+    for (int i=c->nhead; i<c->nst; i++)
+        if (is_barrier(c, i))
+            for (uint16_t ch=0; ch<c->nch; ch++) stage_begin_analysis(&c->st[i].ch[ch]);
+    c->live_n = 0;
+    return 1;
+}
+
+uint32_t chain_process_live(FxChain *c, float **x, uint32_t n){
+    if (n > c->block) n = c->block;
+    if (c->nhead){
+        c->feed.x = x;
+        c->feed.pos = 0;
+        c->feed.base.length = n;
+        PROF_BEGIN(pm);
+        c->head->read(c->head, x, n);
+        PROF_END(pm, c->prof_head, n * c->nch, (uint64_t)8 * n * c->nch, c->prof_head_name, c->prof_name,
+                 PROF_ALL_CH);
+    }
+    c->live_n += n;
+    for (int lo=c->nhead; lo<c->nst; ){
+        if (is_barrier(c, lo)){
+            Stage *s = &c->st[lo];
+            stage_analyze_all(c, s, x, n);
+            for (uint16_t ch=0; ch<c->nch; ch++) stage_resolve(s, &s->ch[ch], c->live_n);
+        }
+        int hi = lo + 1;
+        while (hi < c->nst && !is_barrier(c, hi)) hi++;
+        chain_run_stages(c, lo, hi, x, n);
+        lo = hi;
+    }
+    chain_apply_tail(c, x, n);
+    return n;
+}
+
+uint32_t chain_pull(FxChain *c, float **out, uint32_t count){
+    if (count > c->block) count = c->block;
+    uint32_t n = chain_run(c, out, count, c->nst);
+    if (n) chain_apply_tail(c, out, n);
+    return n;
+}
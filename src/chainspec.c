@@ -0,0 +1,163 @@
+#include "chainspec.h"
+
+#include <ctype.h>
+
+enum {
+    OP_RESAMPLE, OP_DECIMATE, OP_PITCH, OP_GAIN, OP_HIGHPASS, OP_LOWPASS,
+    OP_PEAK, OP_BANDLIMIT, OP_BANDPASS_BOOST, OP_PEAK_NORM, OP_RMS_NORM,
+    OP_TANH, OP_RING_MOD, OP_TREMOLO, OP_BITCRUSH, OP_NOISE, OP_CLIP, OP_REVERB
+};
+
+static const struct {
+    const char *name;
+    int         op, min_args, max_args;
+} spec_ops[] = {
+    { "resample",       OP_RESAMPLE,       1, 2 },
+    { "decimate",       OP_DECIMATE,       1, 1 },
+    { "pitch",          OP_PITCH,          1, 1 },
+    { "gain",           OP_GAIN,           1, 1 },
+    { "highpass",       OP_HIGHPASS,       1, 2 },
+    { "lowpass",        OP_LOWPASS,        1, 2 },
+    { "peak",           OP_PEAK,           3, 3 },
+    { "bandlimit",      OP_BANDLIMIT,      2, 2 },
+    { "bandpass_boost", OP_BANDPASS_BOOST, 3, 3 },
+    { "peak_norm",      OP_PEAK_NORM,      1, 1 },
+    { "rms_norm",       OP_RMS_NORM,       1, 1 },
+    { "tanh",           OP_TANH,           1, 1 },
+    { "ring_mod",       OP_RING_MOD,       1, 2 },
+    { "tremolo",        OP_TREMOLO,        2, 2 },
+    { "bitcrush",       OP_BITCRUSH,       1, 1 },
+    { "noise",          OP_NOISE,          1, 1 },
+    { "clip",           OP_CLIP,           0, 0 },
+    { "reverb",         OP_REVERB,         7, 7 + 2*TAPDELAY_MAX_TAPS },
+};
+
+#define SPEC_NOPS ((int)(sizeof(spec_ops)/sizeof(spec_ops[0])))
+
+void chainspec_init(ChainSpec *s){
+    s->n = 0;
+}
+
+/* rt60 > 0, damping in [0,1), wet in [0,1], every delay in (0, REVERB_MAX_SEC];
+   the four FDN times may all be 0 for early reflections only */
+static int reverb_args_ok(const SpecStage *st){
+    const float *a = st->arg;
+    if (!(a[0] > 0.0f) || a[1] < 0.0f || a[1] >= 1.0f || a[2] < 0.0f || a[2] > 1.0f) return 0;
+    int early_only = a[3] == 0.0f && a[4] == 0.0f && a[5] == 0.0f && a[6] == 0.0f;
+    for (int k=3;k<st->nargs;k++){
+        if ((k < 7 && early_only) || (k >= 7 && (k - 7) % 2)) continue;
+        if (!(a[k] > 0.0f) || a[k] > REVERB_MAX_SEC) return 0;
+    }
+    return 1;
+}
+
+int chainspec_parse_line(ChainSpec *s, const char *line){
+    const char *p = line;
+    while (*p && isspace((unsigned char)*p)) p++;
+    if (!*p || *p == '#') return 1;
+
+    const char *w = p;
+    while (*p && !isspace((unsigned char)*p) && *p != '#') p++;
+    size_t len = (size_t)(p - w);
+    int k = 0;
+    while (k < SPEC_NOPS && !(strlen(spec_ops[k].name) == len && strncmp(spec_ops[k].name, w, len) == 0)) k++;
+    if (k == SPEC_NOPS || s->n == CHAIN_SPEC_STAGES) return 0;
+
+    SpecStage st;
+    memset(&st,0,sizeof(st));
+    st.op = spec_ops[k].op;
+    for (;;){
+        while (*p && isspace((unsigned char)*p)) p++;
+        if (!*p || *p == '#') break;
+        char *end;
+        float v = strtof(p, &end);
+        if (end == p || !isfinite(v) || st.nargs == CHAIN_SPEC_ARGS) return 0;
+        if (*end && !isspace((unsigned char)*end) && *end != '#') return 0;
+        st.arg[st.nargs++] = v;
+        p = end;
+    }
+    if (st.nargs < spec_ops[k].min_args || st.nargs > spec_ops[k].max_args) return 0;
+    if (st.op == OP_REVERB && ((st.nargs - 7) % 2 || !reverb_args_ok(&st))) return 0;
+    if (st.op == OP_PITCH && fabsf(st.arg[0]) > PITCH_MAX_SEMITONES) return 0;
+    /* head stages (resample, decimate, pitch) only before everything else */
+    int head = st.op == OP_RESAMPLE || st.op == OP_DECIMATE || st.op == OP_PITCH;
+    if (head && s->n && !(s->st[s->n-1].op == OP_RESAMPLE || s->st[s->n-1].op == OP_DECIMATE
+                          || s->st[s->n-1].op == OP_PITCH)) return 0;
+    s->st[s->n++] = st;
+    return 1;
+}
+
+int chainspec_parse(ChainSpec *s, const char *text, int *bad_line){
+    char line[512];
+    int no = 0;
+    while (*text){
+        const char *eol = strchr(text, '\n');
+        size_t len = eol ? (size_t)(eol - text) : strlen(text);
+        no++;
+        int ok = len < sizeof(line);
+        if (ok){
+            memcpy(line, text, len);
+            line[len] = 0;
+            ok = chainspec_parse_line(s, line);
+        }
+        if (!ok){
+            if (bad_line) *bad_line = no;
+            return 0;
+        }
+        text += len + (eol ? 1 : 0);
+    }
+    return 1;
+}
+
+static int build_stage(const SpecStage *st, FxChain *c){
+    const float *a = st->arg;
+    float sr = c->sr;
+    switch (st->op){
+        case OP_RESAMPLE: {
+            int q = st->nargs > 1 ? (int)a[1] : RS_QUALITY_HIGH;
+            if (q < RS_QUALITY_FAST || q > RS_QUALITY_HIGH) return 0;
+            return a[0] > 0.0f && chain_add(c, ST_RESAMPLE, a[0], (float)q);
+        }
+        case OP_DECIMATE: {
+            float target = a[0];
+            if (target <= 0.0f) return 0;
+            if (target >= 0.8f * sr) target = fmaxf(1000.0f, 0.5f * sr * 0.6f);
+            return chain_add(c, ST_RESAMPLE, target / sr, RS_QUALITY_MEDIUM)
+                && chain_add(c, ST_RESAMPLE, sr / target, RS_QUALITY_MEDIUM);
+        }
+        case OP_PITCH:     return chain_add(c, ST_PITCH, powf(2.0f, a[0] / 12.0f), 0);
+        case OP_GAIN:      return chain_add(c, ST_GAIN, db_to_lin(a[0]), 0);
+        case OP_HIGHPASS:  return chain_add_biquad(c, biquad_highpass(sr, a[0], st->nargs > 1 ? a[1] : 0.707f));
+        case OP_LOWPASS:   return chain_add_biquad(c, biquad_lowpass(sr, a[0], st->nargs > 1 ? a[1] : 0.707f));
+        case OP_PEAK:      return chain_add_biquad(c, biquad_peak(sr, a[0], a[1], a[2]));
+        case OP_BANDLIMIT: return chain_add_bandlimit(c, a[0], a[1]);
+        case OP_BANDPASS_BOOST: return chain_add_bandpass_boost(c, a[0], a[1], a[2]);
+        case OP_PEAK_NORM: return chain_add(c, ST_PEAK_NORM, a[0], 0);
+        case OP_RMS_NORM:  return chain_add(c, ST_RMS_NORM, a[0], 0);
+        case OP_TANH:      return chain_add(c, ST_TANH, a[0], 0);
+        case OP_RING_MOD:  return chain_add(c, ST_RING_MOD, a[0], st->nargs > 1 ? a[1] : 1.0f);
+        case OP_TREMOLO:   return chain_add(c, ST_TREMOLO, a[0], a[1]);
+        case OP_BITCRUSH:  return chain_add(c, ST_BITCRUSH, a[0], 0);
+        case OP_NOISE:     return chain_add(c, ST_NOISE, a[0], 0);
+        case OP_CLIP:      return chain_add(c, ST_CLIP, 0, 0);
+        case OP_REVERB: {
+            ReverbParams rv;
+            memset(&rv,0,sizeof(rv));
+            rv.rt60 = a[0]; rv.damping = a[1]; rv.wet = a[2];
+            for (int k=0;k<FDN_LINES;k++) rv.fdn_sec[k] = a[3+k];
+            rv.ntaps = (st->nargs - 7) / 2;
+            for (int k=0;k<rv.ntaps;k++){
+                rv.tap_sec[k] = a[7+2*k];
+                rv.tap_gain[k] = a[8+2*k];
+            }
+            return chain_add_reverb(c, &rv);
+        }
+    }
+    return 0;
+}
+
+int chainspec_build(const ChainSpec *s, FxChain *c){
+    for (int i=0;i<s->n;i++)
+        if (!build_stage(&s->st[i], c)) return 0;
+    return 1;
+}
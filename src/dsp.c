@@ -1,11 +1,13 @@
 #include "dsp.h"
+#include "simd.h"
 
 float db_to_lin(float db){ return powf(10.0f, db/20.0f); }
-float randf_uniform(){ return (float)rand() / (float)RAND_MAX; }
-float randf_normal() {
-    float u1 = fmaxf(1e-12f, randf_uniform());
-    float u2 = randf_uniform();
-    return sqrtf(-2.0f*logf(u1)) * cosf(2.0f*(float)M_PI*u2);
+uint32_t seed_mix(uint32_t a, uint32_t b){
+    uint32_t x = a ^ (b * 0x9E3779B9u);
+    x ^= x >> 16; x *= 0x85EBCA6Bu;
+    x ^= x >> 13; x *= 0xC2B2AE35u;
+    x ^= x >> 16;
+    return x;
 }
 
 Biquad biquad_lowpass(float sr, float fc, float q){
@@ -43,31 +45,75 @@ Biquad biquad_peak(float sr, float fc, float q, float gain_db){
 void biquad_process_inplace(float *x, uint32_t n, Biquad *q){
     float z1=q->z1, z2=q->z2;
     float b0=q->b0, b1=q->b1, b2=q->b2, a1=q->a1, a2=q->a2;
-    for (uint32_t i=0;i<n;i++){
-        float in = x[i];
-        float out = b0*in + z1;
-        z1 = b1*in + z2 - a1*out;
-        z2 = b2*in - a2*out;
-        x[i] = out;
+    for (uint32_t off=0; off<n; off+=SOS_BLOCK){
+        uint32_t end = (n - off < SOS_BLOCK) ? n : off + SOS_BLOCK;
+        for (uint32_t i=off;i<end;i++){
+            float in = x[i];
+            float out = b0*in + z1;
+            z1 = b1*in + z2 - a1*out;
+            z2 = b2*in - a2*out;
+            x[i] = out;
+        }
+        z1 = flush_denormal(z1); z2 = flush_denormal(z2);
     }
     q->z1=z1; q->z2=z2;
 }
 
-void peak_normalize(float *x, uint32_t n, float target_db){
-    float t = db_to_lin(target_db);
-    float peak = 1e-9f;
+float peak_abs(const float *x, uint32_t n, float peak){
     for (uint32_t i=0;i<n;i++){ float a=fabsf(x[i]); if (a>peak) peak=a; }
-    float g = t/peak;
+    return peak;
+}
+double sum_squares(const float *x, uint32_t n, double acc){
+    for (uint32_t i=0;i<n;i++){ acc += (double)x[i]*(double)x[i]; }
+    return acc;
+}
+void apply_gain(float *x, uint32_t n, float g){
     for (uint32_t i=0;i<n;i++) x[i]*=g;
 }
+
+void sos_init(Sos *s){ memset(s,0,sizeof(*s)); }
+int sos_add(Sos *s, Biquad q){
+    if (s->nstages >= SOS_MAX_STAGES) return 0;
+    s->st[s->nstages++] = q;
+    return 1;
+}
+void sos_reset(Sos *s){
+    for (int k=0;k<s->nstages;k++) s->st[k].z1 = s->st[k].z2 = 0.0f;
+}
+void sos_process(Sos *s, float *x, uint32_t n){
+    for (uint32_t off=0; off<n; off+=SOS_BLOCK){
+        uint32_t cnt = (n - off < SOS_BLOCK) ? n - off : SOS_BLOCK;
+        for (int k=0;k<s->nstages;k++) biquad_process_inplace(x+off, cnt, &s->st[k]);
+    }
+}
+int sos_bandlimit(Sos *s, float sr, float f_lo, float f_hi){
+    float ny = 0.5f * sr;
+    if (f_lo < 10.0f) f_lo = 10.0f;
+    if (f_hi > ny - 200.0f) f_hi = ny - 200.0f;
+    if (f_hi < f_lo + 50.0f) f_hi = f_lo + 50.0f;
+    return sos_add(s, biquad_highpass(sr, f_lo, 0.707f))
+        && sos_add(s, biquad_lowpass(sr, f_hi, 0.707f));
+}
+int sos_bandpass_boost(Sos *s, float sr, float f_center, float q, float gain_db){
+    float ny = 0.5f * sr;
+    float flo = fmaxf(50.0f, f_center/3.0f);
+    float fhi = fminf(ny - 200.0f, f_center*3.0f);
+    if (fhi < flo + 50.0f) fhi = flo + 50.0f;
+    return sos_bandlimit(s, sr, flo, fhi)
+        && sos_add(s, biquad_peak(sr, f_center, q, gain_db));
+}
+
+void peak_normalize(float *x, uint32_t n, float target_db){
+    float t = db_to_lin(target_db);
+    float peak = peak_abs(x, n, 1e-9f);
+    apply_gain(x, n, t/peak);
+}
 void rms_normalize(float *x, uint32_t n, float target_db){
     float t = db_to_lin(target_db);
-    double acc=0.0;
-    for (uint32_t i=0;i<n;i++){ acc += (double)x[i]*(double)x[i]; }
+    double acc = sum_squares(x, n, 0.0);
     float rms = sqrtf((float)(acc/(double)n));
     if (rms < 1e-9f) return;
-    float g = t/rms;
-    for (uint32_t i=0;i<n;i++) x[i]*=g;
+    apply_gain(x, n, t/rms);
 }
 void soft_limiter_tanh(float *x, uint32_t n, float drive_db){
     float d = db_to_lin(drive_db);
@@ -77,23 +123,94 @@ void soft_limiter_tanh(float *x, uint32_t n, float drive_db){
         x[i] = y / denom;
     }
 }
-void ring_mod(float *x, uint32_t n, float sr, float f_hz, float depth){
-    float ph = 0.0f, dph = 2.0f*(float)M_PI*f_hz/sr;
-    for (uint32_t i=0;i<n;i++){
-        float lfo = sinf(ph);
-        float y = (1.0f - depth)*x[i] + depth*(x[i]*lfo);
-        x[i]=y;
-        ph += dph; if (ph > 2.0f*(float)M_PI) ph -= 2.0f*(float)M_PI;
+#define TANH_CLAMP 7.90531110763549805f
+#define TANH_TINY  4e-4f
+#define TANH_P13 -2.76076847742355e-16f
+#define TANH_P11  2.00018790482477e-13f
+#define TANH_P9  -8.60467152213735e-11f
+#define TANH_P7   5.12229709037114e-08f
+#define TANH_P5   1.48572235717979e-05f
+#define TANH_P3   6.37261928875436e-04f
+#define TANH_P1   4.89352455891786e-03f
+#define TANH_Q6   1.19825839466702e-06f
+#define TANH_Q4   1.18534705686654e-04f
+#define TANH_Q2   2.26843463243900e-03f
+#define TANH_Q0   4.89352518554385e-03f
+
+float tanh_fast(float x){
+    if (fabsf(x) < TANH_TINY) return x;
+    if (x > TANH_CLAMP) x = TANH_CLAMP; else if (x < -TANH_CLAMP) x = -TANH_CLAMP;
+    float x2 = x*x;
+    float p = TANH_P13;
+    p = p*x2 + TANH_P11; p = p*x2 + TANH_P9; p = p*x2 + TANH_P7;
+    p = p*x2 + TANH_P5;  p = p*x2 + TANH_P3; p = p*x2 + TANH_P1;
+    float q = TANH_Q6;
+    q = q*x2 + TANH_Q4;  q = q*x2 + TANH_Q2; q = q*x2 + TANH_Q0;
+    return (x*p)/q;
+}
+
+#if SIMD_VEC
+static inline v4sf v4_select(v4si m, v4sf a, v4sf b){
+    return (v4sf)((m & (v4si)a) | (~m & (v4si)b));
+}
+static inline v4sf tanh_fast_v4(v4sf x){
+    const v4sf hi = { TANH_CLAMP, TANH_CLAMP, TANH_CLAMP, TANH_CLAMP };
+    v4sf ax = (v4sf)((v4si)x & 0x7fffffff);
+    v4si tiny = ax < TANH_TINY;
+    v4sf c = v4_select(x > hi, hi, x);
+    c = v4_select(c < -hi, -hi, c);
+    v4sf x2 = c*c;
+    v4sf p = TANH_P13 + (v4sf){0};
+    p = p*x2 + TANH_P11; p = p*x2 + TANH_P9; p = p*x2 + TANH_P7;
+    p = p*x2 + TANH_P5;  p = p*x2 + TANH_P3; p = p*x2 + TANH_P1;
+    v4sf q = TANH_Q6 + (v4sf){0};
+    q = q*x2 + TANH_Q4;  q = q*x2 + TANH_Q2; q = q*x2 + TANH_Q0;
+    return v4_select(tiny, x, (c*p)/q);
+}
+#endif
+
+void soft_limiter_tanh_fast(float *x, uint32_t n, float drive_db){
+    float d = db_to_lin(drive_db);
+    float g = 1.0f / tanhf(d);
+    uint32_t i = 0;
+#if SIMD_VEC
+    for (; i+4<=n; i+=4){
+        v4sf v; memcpy(&v, x+i, 16);
+        v = tanh_fast_v4(v*d) * g;
+        memcpy(x+i, &v, 16);
     }
+#endif
+    for (; i<n; i++) x[i] = tanh_fast(d*x[i]) * g;
 }
-void tremolo(float *x, uint32_t n, float sr, float rate_hz, float depth){
-    float ph = 0.0f, dph = 2.0f*(float)M_PI*rate_hz/sr;
-    for (uint32_t i=0;i<n;i++){
-        float lfo = (1.0f - depth) + depth*(0.5f*(sinf(ph)+1.0f));
-        x[i]*=lfo;
-        ph += dph; if (ph > 2.0f*(float)M_PI) ph -= 2.0f*(float)M_PI;
+
+#define DSP_BLOCK 256
+
+void ring_mod_block(float *x, uint32_t n, Osc *lfo, float depth){
+    float s[DSP_BLOCK];
+    for (uint32_t off=0; off<n; off+=DSP_BLOCK){
+        uint32_t cnt = (n - off < DSP_BLOCK) ? n - off : DSP_BLOCK;
+        float *b = x + off;
+        osc_sin_block(lfo, s, cnt);
+        for (uint32_t i=0;i<cnt;i++) b[i] = (1.0f - depth)*b[i] + depth*(b[i]*s[i]);
+    }
+}
+void tremolo_block(float *x, uint32_t n, Osc *lfo, float depth){
+    float s[DSP_BLOCK];
+    for (uint32_t off=0; off<n; off+=DSP_BLOCK){
+        uint32_t cnt = (n - off < DSP_BLOCK) ? n - off : DSP_BLOCK;
+        float *b = x + off;
+        osc_sin_block(lfo, s, cnt);
+        for (uint32_t i=0;i<cnt;i++) b[i] *= (1.0f - depth) + depth*(0.5f*(s[i]+1.0f));
     }
 }
+void ring_mod(float *x, uint32_t n, float sr, float f_hz, float depth){
+    Osc o; osc_init(&o, sr, f_hz, 0.0f);
+    ring_mod_block(x, n, &o, depth);
+}
+void tremolo(float *x, uint32_t n, float sr, float rate_hz, float depth){
+    Osc o; osc_init(&o, sr, rate_hz, 0.0f);
+    tremolo_block(x, n, &o, depth);
+}
 void bitcrush(float *x, uint32_t n, int bits){
     if (bits < 2) 
         bits = 2;
@@ -106,16 +223,24 @@ void bitcrush(float *x, uint32_t n, int bits){
         x[i] = v*2.0f - 1.0f;
     }
 }
-void add_white_noise_snr(float *x, uint32_t n, float snr_db){
+void add_white_noise_snr(float *x, uint32_t n, float snr_db, Rng *rng){
     double sp=0.0; for (uint32_t i=0;i<n;i++) sp += (double)x[i]*(double)x[i];
     float sig_pow = (float)(sp/(double)n);
     float noise_pow = sig_pow / powf(10.0f, snr_db/10.0f);
     float std = sqrtf(fmaxf(1e-12f, noise_pow));
-    for (uint32_t i=0;i<n;i++){
-        float z = randf_normal() * std;
-        float y = x[i] + z;
-        if (y>1.0f) y=1.0f; else if (y<-1.0f) y=-1.0f;
-        x[i]=y;
+    add_white_noise_std(x, n, std, rng);
+}
+void add_white_noise_std(float *x, uint32_t n, float std, Rng *rng){
+    float z[DSP_BLOCK];
+    for (uint32_t off=0; off<n; off+=DSP_BLOCK){
+        uint32_t cnt = (n - off < DSP_BLOCK) ? n - off : DSP_BLOCK;
+        float *b = x + off;
+        rng_normal_block(rng, z, cnt);
+        for (uint32_t i=0;i<cnt;i++){
+            float y = b[i] + z[i]*std;
+            if (y>1.0f) y=1.0f; else if (y<-1.0f) y=-1.0f;
+            b[i]=y;
+        }
     }
 }
 void clip_safe(float *x, uint32_t n){
@@ -124,24 +249,35 @@ void clip_safe(float *x, uint32_t n){
     }
 }
 
+void fused_process(const FusedOp *ops, int nops, float *x, uint32_t n){
+    for (uint32_t off=0; off<n; off+=DSP_BLOCK){
+        uint32_t cnt = (n - off < DSP_BLOCK) ? n - off : DSP_BLOCK;
+        float *b = x + off;
+        for (int j=0;j<nops;j++){
+            const FusedOp *op = &ops[j];
+            switch (op->kind){
+                case FOP_GAIN:      apply_gain(b, cnt, op->a); break;
+                case FOP_TANH:      soft_limiter_tanh(b, cnt, op->a); break;
+                case FOP_TANH_FAST: soft_limiter_tanh_fast(b, cnt, op->a); break;
+                case FOP_BITCRUSH:  bitcrush(b, cnt, (int)op->a); break;
+                case FOP_CLIP:      clip_safe(b, cnt); break;
+                case FOP_RING_MOD:  ring_mod_block(b, cnt, op->lfo, op->a); break;
+                case FOP_TREMOLO:   tremolo_block(b, cnt, op->lfo, op->a); break;
+                case FOP_NOISE:     add_white_noise_std(b, cnt, op->a, op->rng); break;
+            }
+        }
+    }
+}
+
 void bandlimit(float *x, uint32_t n, float sr, float f_lo, float f_hi){
-    float ny = 0.5f * sr;
-    if (f_lo < 10.0f) f_lo = 10.0f;
-    if (f_hi > ny - 200.0f) f_hi = ny - 200.0f;
-    if (f_hi < f_lo + 50.0f) f_hi = f_lo + 50.0f;
-    Biquad hp = biquad_highpass(sr, f_lo, 0.707f);
-    Biquad lp = biquad_lowpass(sr, f_hi, 0.707f);
-    biquad_process_inplace(x,n,&hp);
-    biquad_process_inplace(x,n,&lp);
+    Sos s; sos_init(&s);
+    sos_bandlimit(&s, sr, f_lo, f_hi);
+    sos_process(&s, x, n);
 }
 void bandpass_boost(float *x, uint32_t n, float sr, float f_center, float q, float gain_db){
-    float ny = 0.5f * sr;
-    float flo = fmaxf(50.0f, f_center/3.0f);
-    float fhi = fminf(ny - 200.0f, f_center*3.0f);
-    if (fhi < flo + 50.0f) fhi = flo + 50.0f;
-    bandlimit(x,n,sr,flo,fhi);
-    Biquad pk = biquad_peak(sr,f_center,q,gain_db);
-    biquad_process_inplace(x,n,&pk);
+    Sos s; sos_init(&s);
+    sos_bandpass_boost(&s, sr, f_center, q, gain_db);
+    sos_process(&s, x, n);
 }
 
 float* resample_linear(const float *x, uint32_t n, float ratio, uint32_t *out_n){
@@ -172,16 +308,23 @@ uint32_t pitch_shift_change_duration(float **px, uint32_t n, float semitones){
     return n_out;
 }
 
-void pitch_shift_simple(float *x, uint32_t n, float semitones){
+void pitch_shift_simple(float *x, uint32_t n, float sr, float semitones){
     float r = powf(2.0f, semitones / 12.0f);
-    if (!isfinite(r) || r <= 0.0f) return;
-    uint32_t n1=0; float *y = resample_linear(x, n, 1.0f / r, &n1);
-    if (!y) return;
-    uint32_t n2=0; float *z = resample_linear(y, n1, r, &n2);
-    free(y);
-    if (!z) return;
-    uint32_t cpy = (n2 < n) ? n2 : n;
-    memcpy(x, z, sizeof(float)*cpy);
-    if (n2 < n) memset(x+cpy, 0, sizeof(float)*(n - cpy));
-    free(z);
+    if (!isfinite(r) || r <= 0.0f || !n) return;
+    PitchShifter ps;
+    if (!pitch_shifter_init(&ps, sr, r, NULL)) return;
+    uint32_t d = ps.latency;
+    float *tail = (float*)calloc(d, sizeof(float));
+    if (tail){
+        pitch_shifter_process(&ps, x, n);
+        pitch_shifter_process(&ps, tail, d);
+        if (n > d){
+            memmove(x, x + d, sizeof(float)*(n - d));
+            memcpy(x + n - d, tail, sizeof(float)*d);
+        } else {
+            memcpy(x, tail + (d - n), sizeof(float)*n);
+        }
+        free(tail);
+    }
+    pitch_shifter_free(&ps);
 }
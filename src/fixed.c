@@ -0,0 +1,338 @@
+#include "fixed.h"
+#include "simd.h"
+
+static inline int32_t sat32(int64_t v){
+    return v > INT32_MAX ? INT32_MAX : v < INT32_MIN ? INT32_MIN : (int32_t)v;
+}
+
+FixedGain fixed_gain(double g){
+    FixedGain r = { 0, 1 };
+    if (!(g > 0.0)) return r;
+    int e;
+    double m = frexp(g, &e);
+    int64_t q = llrint(m * 2147483648.0);
+    if (q > INT32_MAX){ q >>= 1; e++; }
+    int sh = 31 - e;
+    if (sh < 1){ r.m = INT32_MAX; return r; }
+    if (sh > 62) return r;
+    r.m = (int32_t)q;
+    r.sh = sh;
+    return r;
+}
+
+static inline int64_t gain_mul(int32_t x, FixedGain g){
+    return ((int64_t)x * g.m + ((int64_t)1 << (g.sh - 1))) >> g.sh;
+}
+
+static int coef_q(float c, int32_t *q){
+    double v = ldexp((double)c, FIXED_COEF_FRAC);
+    if (!(fabs(v) < 2147483647.0)) return 0;
+    *q = (int32_t)llrint(v);
+    return 1;
+}
+
+static int biquad_q(const Biquad *b, FixedBiquad *q){
+    return coef_q(b->b0, &q->b0) && coef_q(b->b1, &q->b1) && coef_q(b->b2, &q->b2)
+        && coef_q(b->a1, &q->a1) && coef_q(b->a2, &q->a2);
+}
+
+static int stage_supported(const Stage *s){
+    FixedBiquad q;
+    switch (s->kind){
+        case ST_SOS:
+            for (int k=0;k<s->coef.nstages;k++)
+                if (!biquad_q(&s->coef.st[k], &q)) return 0;
+            return 1;
+        case ST_GAIN: case ST_PEAK_NORM: case ST_TANH: case ST_BITCRUSH: case ST_CLIP:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+int fixed_chain_supported(const FxChain *c){
+    for (int i=0;i<c->nst;i++)
+        if (!stage_supported(&c->st[i])) return 0;
+    return 1;
+}
+
+/* tanh(d*x)/tanhf(d) at multiples of 2^sh, up to where tanhf reaches 1.
+   tanh(y) = 1 - 2/(e^2y + 1), with e^2y stepped by one multiply per point:
+   the relative error grows by an ulp of a double per step, far below Q24 */
+static int tanh_table(FixedStage *s, Arena *mem){
+    float d = db_to_lin(s->a), den = tanhf(d);
+    double end = 9.1 / d * FIXED_ONE;
+    int sh = 0;
+    while (sh < 31 && ldexp(FIXED_TANH_N, sh) < end) sh++;
+    s->tanh = (int32_t*)arena_alloc(mem, (FIXED_TANH_N + 1) * sizeof(int32_t));
+    if (!s->tanh) return 0;
+    double step = exp(2.0 * d * ldexp(1.0, sh - FIXED_FRAC)), e = 1.0;
+    for (int i=0;i<=FIXED_TANH_N;i++, e *= step)
+        s->tanh[i] = (int32_t)llrint(ldexp((1.0 - 2.0 / (e + 1.0)) / den, FIXED_FRAC));
+    s->tanh_sh = sh;
+    return 1;
+}
+
+int fixed_chain_init(FixedChain *f, const FxChain *c, Arena *mem){
+    memset(f, 0, sizeof(*f));
+    f->mem = mem;
+    f->nch = c->nch;
+    if (!fixed_chain_supported(c)) return 0;
+    f->st = (FixedStage*)arena_calloc(mem, c->nst ? c->nst : 1, sizeof(FixedStage));
+    if (!f->st) return 0;
+    f->nst = f->nrun = c->nst;
+    if (f->nst && c->st[f->nst-1].kind == ST_PEAK_NORM) f->nrun--;
+
+    for (int i=0;i<c->nst;i++){
+        const Stage *s = &c->st[i];
+        FixedStage *d = &f->st[i];
+        d->kind = s->kind;
+        d->a = s->a;
+        d->ch = (FixedChanState*)arena_calloc(mem, c->nch, sizeof(FixedChanState));
+        if (!d->ch){ fixed_chain_free(f); return 0; }
+        for (uint16_t ch=0; ch<c->nch; ch++) d->ch[ch].g = fixed_gain(1.0);
+        switch (s->kind){
+            case ST_SOS:
+                d->nsec = s->coef.nstages;
+                for (int k=0;k<d->nsec;k++) biquad_q(&s->coef.st[k], &d->sec[k]);
+                break;
+            case ST_GAIN:
+                d->gain = fixed_gain(s->a);
+                break;
+            case ST_TANH:
+                if (!tanh_table(d, mem)){ fixed_chain_free(f); return 0; }
+                break;
+            case ST_BITCRUSH: {
+                int bits = (int)s->a;
+                if (bits < 2) bits = 2;
+                if (bits > 16) bits = 16;
+                d->crush_levels = (1 << bits) - 1;
+                d->crush_step = llrint(ldexp(1.0, FIXED_FRAC + 1 + 16) / d->crush_levels);
+            } break;
+            default: break;
+        }
+    }
+    return 1;
+}
+
+void fixed_chain_free(FixedChain *f){
+    for (int i=0; f->st && i<f->nst; i++){
+        arena_free(f->mem, f->st[i].tanh);
+        arena_free(f->mem, f->st[i].ch);
+    }
+    arena_free(f->mem, f->st);
+    f->st = NULL;
+    f->nst = f->nrun = 0;
+}
+
+/* ---- kernels, in place on one tile of one channel ---- */
+
+/* direct form I; the bits shifted out are fed into the next sample, so
+   the rounding error is shaped away from the poles near DC */
+static inline int32_t df1_step(const FixedBiquad *q, FixedBiquadState *z, int32_t x){
+    const int64_t mask = ((int64_t)1 << FIXED_COEF_FRAC) - 1;
+    int64_t acc = (int64_t)q->b0*x + (int64_t)q->b1*z->x1 + (int64_t)q->b2*z->x2
+                - (int64_t)q->a2*z->y2 + z->err - (int64_t)q->a1*z->y1;
+    int32_t y = sat32(acc >> FIXED_COEF_FRAC);
+    z->err = acc & mask;
+    z->x2 = z->x1; z->x1 = x;
+    z->y2 = z->y1; z->y1 = y;
+    return y;
+}
+
+/* sections two at a time in one pass over the tile: their recursions are
+   independent chains, so one runs while the other waits on its multiply */
+static void sos_run(const FixedStage *s, FixedChanState *t, int32_t *x, uint32_t n){
+    int k = 0;
+    for (; k+2<=s->nsec; k+=2){
+        const FixedBiquad q0 = s->sec[k], q1 = s->sec[k+1];
+        FixedBiquadState z0 = t->z[k], z1 = t->z[k+1];
+        for (uint32_t i=0;i<n;i++) x[i] = df1_step(&q1, &z1, df1_step(&q0, &z0, x[i]));
+        t->z[k] = z0; t->z[k+1] = z1;
+    }
+    if (k < s->nsec){
+        const FixedBiquad q = s->sec[k];
+        FixedBiquadState z = t->z[k];
+        for (uint32_t i=0;i<n;i++) x[i] = df1_step(&q, &z, x[i]);
+        t->z[k] = z;
+    }
+}
+
+static void gain_run(FixedGain g, int32_t *x, uint32_t n){
+    for (uint32_t i=0;i<n;i++) x[i] = sat32(gain_mul(x[i], g));
+}
+
+static void tanh_run(const FixedStage *s, int32_t *x, uint32_t n){
+    const int32_t *t = s->tanh;
+    int sh = s->tanh_sh;
+    uint32_t frac = (uint32_t)(((uint64_t)1 << sh) - 1);
+    for (uint32_t i=0;i<n;i++){
+        int32_t v = x[i];
+        uint32_t u = v < 0 ? 0u - (uint32_t)v : (uint32_t)v;
+        uint32_t k = u >> sh;
+        int32_t y = k >= FIXED_TANH_N ? t[FIXED_TANH_N]
+                  : t[k] + (int32_t)(((int64_t)(t[k+1] - t[k]) * (u & frac)) >> sh);
+        x[i] = v < 0 ? -y : y;
+    }
+}
+
+/* bitcrush(): v = (x+1)/2 rounded to `levels` steps, mapped back */
+static void crush_run(const FixedStage *s, int32_t *x, uint32_t n){
+    for (uint32_t i=0;i<n;i++){
+        int64_t t = ((int64_t)x[i] + FIXED_ONE) * s->crush_levels;
+        int64_t q = (t + FIXED_ONE) >> (FIXED_FRAC + 1);
+        x[i] = sat32(((q * s->crush_step + ((int64_t)1 << 15)) >> 16) - FIXED_ONE);
+    }
+}
+
+static void clip_run(int32_t *x, uint32_t n){
+    uint32_t i = 0;
+#if SIMD_VEC
+    const v4si hi = { FIXED_ONE, FIXED_ONE, FIXED_ONE, FIXED_ONE }, lo = -hi;
+    for (; i+4<=n; i+=4){
+        v4si v; memcpy(&v, x+i, 16);
+        v4si m = v > hi;
+        v = (v & ~m) | (hi & m);
+        m = v < lo;
+        v = (v & ~m) | (lo & m);
+        memcpy(x+i, &v, 16);
+    }
+#endif
+    for (; i<n; i++){
+        if (x[i] > FIXED_ONE) x[i] = FIXED_ONE; else if (x[i] < -FIXED_ONE) x[i] = -FIXED_ONE;
+    }
+}
+
+static void stage_run(const FixedStage *s, FixedChanState *t, int32_t *x, uint32_t n){
+    switch (s->kind){
+        case ST_SOS:       sos_run(s, t, x, n); break;
+        case ST_GAIN:      gain_run(s->gain, x, n); break;
+        case ST_PEAK_NORM: gain_run(t->g, x, n); break;
+        case ST_TANH:      tanh_run(s, x, n); break;
+        case ST_BITCRUSH:  crush_run(s, x, n); break;
+        case ST_CLIP:      clip_run(x, n); break;
+        default: break;
+    }
+}
+
+/* channel c of n interleaved PCM16 frames to Q24, scaled like wav_decode() */
+static void load(int32_t *x, const uint8_t *src, uint16_t ch, uint16_t c, uint32_t n){
+    const uint8_t *b = src + 2*c;
+    for (uint32_t i=0;i<n;i++, b += 2*ch)
+        x[i] = (int32_t)(int16_t)(uint16_t)(b[0] | (b[1] << 8)) * (1 << (FIXED_FRAC - 15));
+}
+
+/* and back, quantized and clamped to +-32767 as the writer does */
+static void store(uint8_t *dst, const int32_t *x, uint16_t ch, uint16_t c, uint32_t n, FixedGain g){
+    uint8_t *b = dst + 2*c;
+    for (uint32_t i=0;i<n;i++, b += 2*ch){
+        int64_t v = gain_mul(x[i], g);
+        if (v > 32767) v = 32767; else if (v < -32767) v = -32767;
+        b[0] = (uint8_t)(v & 0xFF); b[1] = (uint8_t)((v >> 8) & 0xFF);
+    }
+}
+
+static uint32_t peak_q(const int32_t *x, uint32_t n, uint32_t peak){
+    for (uint32_t i=0;i<n;i++){
+        uint32_t u = x[i] < 0 ? 0u - (uint32_t)x[i] : (uint32_t)x[i];
+        if (u > peak) peak = u;
+    }
+    return peak;
+}
+
+/* Before the final gain is known a tile is kept as 16-bit mantissas of
+   its own peak: the rounding is under half a step of that peak, so under
+   half an output LSB once the gain brings the file peak to full scale.
+   Returns the tile peak. */
+static uint32_t store_mant(uint8_t *dst, const int32_t *x, uint16_t ch, uint16_t c, uint32_t n){
+    uint32_t p = peak_q(x, n, 0);
+    FixedGain g = fixed_gain(p ? 32767.0 / p : 0.0);
+    uint8_t *b = dst + 2*c;
+    for (uint32_t i=0;i<n;i++, b += 2*ch){
+        int32_t v = (int32_t)gain_mul(x[i], g);
+        b[0] = (uint8_t)(v & 0xFF); b[1] = (uint8_t)((v >> 8) & 0xFF);
+    }
+    return p;
+}
+
+static void rescale(uint8_t *dst, uint16_t ch, uint16_t c, uint32_t n, FixedGain g){
+    uint8_t *b = dst + 2*c;
+    for (uint32_t i=0;i<n;i++, b += 2*ch){
+        int64_t v = gain_mul((int16_t)(uint16_t)(b[0] | (b[1] << 8)), g);
+        if (v > 32767) v = 32767; else if (v < -32767) v = -32767;
+        b[0] = (uint8_t)(v & 0xFF); b[1] = (uint8_t)((v >> 8) & 0xFF);
+    }
+}
+
+static void fixed_reset(FixedChain *f){
+    for (int i=0;i<f->nst;i++)
+        for (uint16_t c=0;c<f->nch;c++) memset(f->st[i].ch[c].z, 0, sizeof(f->st[i].ch[c].z));
+}
+
+/* the gain as stage_resolve() computes it */
+static float norm_gain(const FixedStage *s, uint32_t peak){
+    return db_to_lin(s->a) / fmaxf(1e-9f, (float)ldexp(peak, -FIXED_FRAC));
+}
+
+/* normalizes inside the chain: a pass over the stages before each */
+static void analyze(FixedChain *f, const uint8_t *src, uint32_t n){
+    int32_t x[FIXED_BLOCK];
+    size_t fb = (size_t)2 * f->nch;
+    for (int k=0;k<f->nrun;k++){
+        FixedStage *s = &f->st[k];
+        if (s->kind != ST_PEAK_NORM) continue;
+        fixed_reset(f);
+        uint32_t peak[f->nch];
+        memset(peak, 0, sizeof(peak));
+        for (uint32_t off=0; off<n; off+=FIXED_BLOCK){
+            uint32_t cnt = n - off < FIXED_BLOCK ? n - off : FIXED_BLOCK;
+            for (uint16_t c=0;c<f->nch;c++){
+                load(x, src + off*fb, f->nch, c, cnt);
+                for (int j=0;j<k;j++) stage_run(&f->st[j], &f->st[j].ch[c], x, cnt);
+                peak[c] = peak_q(x, cnt, peak[c]);
+            }
+        }
+        for (uint16_t c=0;c<f->nch;c++) s->ch[c].g = fixed_gain(norm_gain(s, peak[c]));
+    }
+    fixed_reset(f);
+}
+
+int fixed_chain_process(FixedChain *f, const uint8_t *src, uint8_t *dst, uint32_t n){
+    int32_t x[FIXED_BLOCK];
+    size_t fb = (size_t)2 * f->nch;
+    size_t ntiles = (n + (size_t)FIXED_BLOCK - 1) / FIXED_BLOCK;
+    int final = f->nrun < f->nst;
+    uint32_t *tpeak = NULL;
+    if (final && !(tpeak = (uint32_t*)arena_alloc(f->mem, (ntiles * f->nch + 1) * sizeof(uint32_t))))
+        return 0;
+    analyze(f, src, n);
+
+    uint32_t peak[f->nch];
+    memset(peak, 0, sizeof(peak));
+    FixedGain unity = fixed_gain(32767.0 / FIXED_ONE);
+    for (size_t t=0; t<ntiles; t++){
+        uint32_t off = (uint32_t)(t * FIXED_BLOCK);
+        uint32_t cnt = n - off < FIXED_BLOCK ? n - off : FIXED_BLOCK;
+        for (uint16_t c=0;c<f->nch;c++){
+            load(x, src + off*fb, f->nch, c, cnt);
+            for (int j=0;j<f->nrun;j++) stage_run(&f->st[j], &f->st[j].ch[c], x, cnt);
+            if (final){
+                uint32_t p = tpeak[t*f->nch + c] = store_mant(dst + off*fb, x, f->nch, c, cnt);
+                if (p > peak[c]) peak[c] = p;
+            } else store(dst + off*fb, x, f->nch, c, cnt, unity);
+        }
+    }
+    if (final){
+        float g[f->nch];
+        for (uint16_t c=0;c<f->nch;c++) g[c] = norm_gain(&f->st[f->nrun], peak[c]);
+        for (size_t t=0; t<ntiles; t++){
+            uint32_t off = (uint32_t)(t * FIXED_BLOCK);
+            uint32_t cnt = n - off < FIXED_BLOCK ? n - off : FIXED_BLOCK;
+            for (uint16_t c=0;c<f->nch;c++)
+                rescale(dst + off*fb, f->nch, c, cnt,
+                        fixed_gain(ldexp((double)g[c] * tpeak[t*f->nch + c], -FIXED_FRAC)));
+        }
+    }
+    arena_free(f->mem, tpeak);
+    return 1;
+}
@@ -0,0 +1,27 @@
+#include "fpmode.h"
+
+#if defined(__SSE__) || defined(__x86_64__)
+#include <xmmintrin.h>
+#define FP_FTZ_DAZ 0x8040u      /* MXCSR FTZ (bit 15) | DAZ (bit 6) */
+#endif
+
+static int ftz_on;
+
+void fpmode_set_ftz(int on){ ftz_on = on != 0; }
+int  fpmode_ftz(void){ return ftz_on; }
+
+int fpmode_apply(void){
+    if (!ftz_on) return 1;
+#if defined(FP_FTZ_DAZ)
+    _mm_setcsr(_mm_getcsr() | FP_FTZ_DAZ);
+    return 1;
+#elif defined(__aarch64__)
+    uint64_t fpcr;
+    __asm__ volatile("mrs %0, fpcr" : "=r"(fpcr));
+    fpcr |= (uint64_t)1 << 24;   /* FZ */
+    __asm__ volatile("msr fpcr, %0" : : "r"(fpcr));
+    return 1;
+#else
+    return 0;
+#endif
+}
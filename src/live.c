@@ -0,0 +1,141 @@
+#include "live.h"
+
+#include <signal.h>
+
+static double now_us(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/* up to `want` bytes, blocking until they arrive or the input ends; bytes
+   read while probing for a header come first */
+static size_t read_input(FILE *f, uint8_t *buf, size_t want, uint8_t *carry, size_t *ncarry){
+    size_t got = 0;
+    if (*ncarry){
+        got = *ncarry < want ? *ncarry : want;
+        memcpy(buf, carry, got);
+        memmove(carry, carry + got, *ncarry - got);
+        *ncarry -= got;
+    }
+    return got + fread(buf + got, 1, want - got, f);
+}
+
+static int cmp_float(const void *a, const void *b){
+    float x = *(const float*)a, y = *(const float*)b;
+    return (x > y) - (x < y);
+}
+
+static void report(float *t, size_t n, double budget_us, uint64_t frames, double sr){
+    if (!n) return;
+    qsort(t, n, sizeof(float), cmp_float);
+    double sum = 0.0;
+    size_t over = 0;
+    for (size_t i=0; i<n; i++){
+        sum += t[i];
+        if (t[i] > budget_us) over++;
+    }
+    #define PCT(p) t[(size_t)((n - 1) * (p) + 0.5)]
+    fprintf(stderr, "Bloklar: %zu (%.2f s audio), ishlov berish vaqti, mks: p50 %.1f | p90 %.1f | p99 %.1f"
+                    " | p99.9 %.1f | max %.1f\n",
+            n, frames / sr, PCT(0.50), PCT(0.90), PCT(0.99), PCT(0.999), t[n-1]);
+    #undef PCT
+    fprintf(stderr, "Blok byudjeti %.1f mks, oshib ketgan bloklar: %zu, o'rtacha yuklama %.2f%%\n",
+            budget_us, over, 100.0 * sum / (budget_us * n));
+}
+
+int live_run(const LiveOptions *lo, const PresetBook *book, int preset, const RenderOptions *opt){
+    FILE *in = stdin;
+    WavInfo wi;
+    memset(&wi, 0, sizeof(wi));
+    uint8_t carry[4];
+    size_t ncarry = fread(carry, 1, 4, in);
+    if (ncarry == 4 && (memcmp(carry, "RIFF", 4) == 0 || memcmp(carry, "RF64", 4) == 0)){
+        if (!read_wav_header_pipe(in, carry, &wi)){
+            fprintf(stderr, "%s\n", render_status_text(RENDER_ERR_FORMAT));
+            return 0;
+        }
+        ncarry = 0;
+    } else {
+        wi.sample_rate = lo->rate;
+        wi.num_channels = lo->channels;
+        wi.format = lo->in_format;
+    }
+    uint16_t ch = wi.num_channels;
+    uint32_t block = lo->block;
+    double sr = (double)wi.sample_rate;
+    WavFormat out_format = opt->out_format < 0 ? wi.format : (WavFormat)opt->out_format;
+    size_t in_fb = (size_t)ch * wav_format_bytes(wi.format);
+    size_t out_fb = (size_t)ch * wav_format_bytes(out_format);
+
+    FxChain chain;
+    if (!preset_book_build(book, preset, &chain, (float)sr, ch, NULL)){
+        fprintf(stderr, "%s\n", render_status_text(RENDER_ERR_NOMEM));
+        return 0;
+    }
+    chain_set_seed(&chain, seed_mix(opt->seed, (uint32_t)preset), 0);
+    chain_set_tanh_mode(&chain, opt->tanh_mode);
+    if (!chain_set_filter_mode(&chain, opt->filter_mode)){
+        fprintf(stderr, "%s\n", render_status_text(RENDER_ERR_NOMEM));
+        chain_free(&chain);
+        return 0;
+    }
+    if (!chain_start_live(&chain, block)){
+        fprintf(stderr, "%s presetini real vaqtda ishlatib bo'lmaydi (resample davomiylikni o'zgartiradi)\n",
+                book->v[preset].name);
+        chain_free(&chain);
+        return 0;
+    }
+    uint32_t latency = chain_latency(&chain);
+
+    float  **x = arena_planes(NULL, ch, block);
+    uint8_t *ibuf = (uint8_t*)malloc(block * in_fb);
+    uint8_t *obuf = (uint8_t*)malloc(block * out_fb);
+    float   *times = NULL;
+    size_t   ntimes = 0, tcap = 0;
+    int ok = x && ibuf && obuf;
+    if (!ok) fprintf(stderr, "%s\n", render_status_text(RENDER_ERR_NOMEM));
+
+    double budget_us = 1e6 * block / sr;
+    fprintf(stderr, "Jonli rejim: %s, %u Hz, %u kanal, blok %u kadr (%.2f ms)\n",
+            book->v[preset].name, wi.sample_rate, ch, block, budget_us / 1e3);
+    fprintf(stderr, "Kechikish: algoritmik %u kadr (%.2f ms) + blok %u kadr = %.2f ms\n",
+            latency, 1e3 * latency / sr, block, 1e3 * (latency + block) / sr);
+
+    signal(SIGPIPE, SIG_IGN);
+    uint64_t frames = 0;
+    uint32_t flush = latency;
+    while (ok){
+        uint32_t n = (uint32_t)(read_input(in, ibuf, block * in_fb, carry, &ncarry) / in_fb);
+        int silence = 0;
+        if (!n){
+            if (!flush) break;
+            n = flush < block ? flush : block;
+            flush -= n;
+            silence = 1;
+        }
+        double t0 = now_us();
+        if (silence) for (uint16_t c=0; c<ch; c++) memset(x[c], 0, sizeof(float) * n);
+        else wav_decode(x, ibuf, wi.format, ch, n);
+        chain_process_live(&chain, x, n);
+        wav_encode(obuf, x, out_format, ch, n);
+        float dt = (float)(now_us() - t0);
+
+        if (ntimes == tcap){
+            size_t cap = tcap ? tcap * 2 : 4096;
+            float *t = (float*)realloc(times, cap * sizeof(float));
+            if (t){ times = t; tcap = cap; }
+        }
+        if (ntimes < tcap) times[ntimes++] = dt;
+        if (fwrite(obuf, out_fb, n, stdout) != n || fflush(stdout) != 0) ok = 0;
+        frames += n;
+    }
+
+    report(times, ntimes, budget_us, frames, sr);
+    free(times);
+    free(ibuf);
+    free(obuf);
+    arena_free_planes(NULL, x, ch);
+    chain_free(&chain);
+    return ok;
+}
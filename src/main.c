@@ -1,86 +1,353 @@
 #include "compat.h"
-#include "wav.h"
-#include "presets.h"
+#include "render.h"
+#include "server.h"
+#include "batch.h"
+#include "live.h"
+#include "pool.h"
+#include "fpmode.h"
+
+#include <unistd.h>
+#include <getopt.h>
+#include <stdatomic.h>
 
 #if BENCH
 #include "bench.h"
 #endif
 
-int main(int argc, char **argv){
-    if (argc < 2){
-        fprintf(stderr, "Foydalanish: %s in.wav\n", argv[0]);
-        return 1;
-    }
-    const char *inpath = argv[1];
-    srand((unsigned)time(NULL));
+typedef struct PresetJob PresetJob;
 
-    FILE *f = fopen(inpath,"rb");
-    if (!f){ fprintf(stderr,"Kirish faylini ochishda xatolik.\n"); return 1; }
+typedef struct {
+    PresetJob *pj;
+    uint16_t   c0, nc;
+} ChanJob;
 
-    WavInfo wi;
-    if (!read_wav_header(f,&wi)){
-        fprintf(stderr,"Qo'llab-quvvatlanilmaydigan WAV fayli. Faqatgina PCM 16-bit bo'lishi lozim\n");
-        fclose(f); return 1;
-    }
+struct PresetJob {
+    const RenderInput *in;
+    const PresetBook  *book;
+    int         preset;
+    uint32_t    latency;
+    float     **x;          /* split by channel: the gathered planes */
+    float      *gain;
+    ChanJob    *chans;
+    atomic_int  left, failed;
+};
 
-    #if BENCH
-        BenchSnapshot s0, s1;
-        bench_snapshot(&s0);
-    #endif
+static void usage(const char *prog){
+    fprintf(stderr, "Foydalanish: %s [-s] [-b kadrlar] [-j N] [-t exact|fast] [--filter direct|block4] [-f format] [-p fayl] [--seed N] in.wav\n", prog);
+    fprintf(stderr, "       %s --batch katalog|ro'yxat [-o shablon] [-P presetlar] [boshqa parametrlar]\n", prog);
+    fprintf(stderr, "       %s --live preset [-b kadrlar] [--rate N] [--channels N] [--in-format format] < in > out\n", prog);
+    fprintf(stderr, "       %s --serve soket [-s] [-b kadrlar] [-j N] [-t ...] [-f ...] [-p fayl] [--seed N]\n", prog);
+    fprintf(stderr, "  -s          oqimli rejim: fayl bloklab o'qiladi va yoziladi\n");
+    fprintf(stderr, "  -b kadrlar  oqimli rejimdagi blok hajmi (standart 4096, --live uchun 256)\n");
+    fprintf(stderr, "  -j N        parallel ishchi oqimlar soni (0 = barcha yadrolar, standart 1)\n");
+    fprintf(stderr, "  -t rejim    limiter tanh: exact (libm, standart) yoki fast (xato < 4e-7)\n");
+    fprintf(stderr, "  --filter r  mono fayllarda filtrlar: direct (standart) yoki block4 (~2x tez, farq ~1e-4 gacha)\n");
+    fprintf(stderr, "  -f format   chiqish formati: 16, 24, 32 (PCM) yoki f32 (standart: kirish formati)\n");
+    fprintf(stderr, "  -p fayl     qo'shimcha presetlar fayli ([nom] va har qatorda bitta bosqich)\n");
+    fprintf(stderr, "  -P p1,p2    faqat shu presetlar (standart: hammasi)\n");
+    fprintf(stderr, "  -o shablon  --batch chiqish yo'li, {name} va {preset} bilan (standart: out/{name}/{preset}.wav)\n");
+    fprintf(stderr, "  --seed N    shovqin generatori uchun boshlang'ich qiymat (standart: vaqt)\n");
+    fprintf(stderr, "  --batch k   katalogdagi yoki ro'yxatdagi barcha fayllarni qayta ishlash\n");
+    fprintf(stderr, "  --live p    stdin'dan stdout'ga real vaqtda bitta preset bilan (WAV yoki xom PCM)\n");
+    fprintf(stderr, "  --rate N, --channels N, --in-format 16|24|32|f32\n");
+    fprintf(stderr, "              sarlavhasiz (xom) kirish uchun (standart: 48000, 1, 16)\n");
+    fprintf(stderr, "  --serve s   Unix soketida navbat xizmati sifatida ishlash (-j ishchilar soni)\n");
+    fprintf(stderr, "  --trace f   bosqichlar profilini Chrome trace JSON sifatida yozish (PROFILE=1)\n");
+    fprintf(stderr, "  --fixed     16-bit PCM kirish va chiqishda mos presetlarni butun sonli (Q24) yo'l bilan\n");
+    fprintf(stderr, "              ishlash: telephone, intercom, walkie_talkie kabi (faqat xotira rejimida)\n");
+    fprintf(stderr, "  --ftz       ishchi oqimlarda FTZ/DAZ: subnormal sonlar nolga tenglanadi\n");
+}
+
+static int parse_format(const char *s){
+    if (strcmp(s, "16") == 0) return WAV_PCM16;
+    if (strcmp(s, "24") == 0) return WAV_PCM24;
+    if (strcmp(s, "32") == 0) return WAV_PCM32;
+    if (strcmp(s, "f32") == 0) return WAV_FLOAT32;
+    return -1;
+}
+
+static void output_name(char *buf, size_t n, const PresetJob *pj){
+    snprintf(buf, n, "out/%s.wav", pj->book->v[pj->preset].name);
+}
 
-    fseek(f, wi.data_offset, SEEK_SET);
-    uint32_t nframes = wi.data_size / (wi.num_channels * 2);
+static void report(const char *outname, int ok, uint32_t latency){
+    if (ok && latency) printf("Chiqish %s (kechikish %u kadr, kompensatsiya qilingan)\n", outname, latency);
+    else if (ok) printf("Chiqish %s\n", outname);
+    else fprintf(stderr,"Faylni saqlashda xatolik %s\n", outname);
+}
 
-    int16_t *pcm = (int16_t*)malloc(wi.data_size);
-    if (!pcm){ fclose(f); fprintf(stderr,"Xotira ajratishda xatolik.\n"); return 1; }
-    if (fread(pcm,1,wi.data_size,f)!=wi.data_size){ free(pcm); fclose(f); fprintf(stderr,"Auduio uzunligi yetarli emas.\n"); return 1; }
-    fclose(f);
+/* the stage table goes to stderr after every run of a PROFILE=1 build */
+static int profile_done(const char *trace_path){
+#if PROFILE
+    prof_report("chain stages");
+    if (trace_path && !prof_write_trace(trace_path)){
+        fprintf(stderr, "Trace faylini yozishda xatolik: %s\n", trace_path);
+        return 0;
+    }
+#else
+    (void)trace_path;
+#endif
+    return 1;
+}
 
-    float *buf_orig = (float*)malloc(sizeof(float)*nframes*wi.num_channels);
-    if (!buf_orig){ free(pcm); fprintf(stderr,"Xotira ajratishda xatolik.\n"); return 1; }
-    for (uint32_t i=0;i<nframes*wi.num_channels;i++) buf_orig[i] = (float)pcm[i] / 32768.0f;
-    free(pcm);
+static void render_job(void *arg, Arena *scratch){
+    PresetJob *pj = (PresetJob*)arg;
+    char outname[512];
+    output_name(outname, sizeof(outname), pj);
+    int ok = render_preset(pj->in, pj->book, pj->preset, outname, scratch);
+    if (!ok) atomic_store(&pj->failed, 1);
+    report(outname, ok, pj->latency);
+}
 
-    const char *preset_names[] = {
-        "none","normalize_peak","normalize_rms","sweeten","radio_vo",
-        "telephone","walkie_talkie","megaphone","stadium_pa","cave",
-        "cathedral","underwater","intercom","vinyl_lofi","robot_ringmod",
-        "alien_robot","chipmunk","baritone","deep_voice","whisperish","pitch_up_fun"
+/* one channel group of a split preset; the last one to finish writes it */
+static void chan_job(void *arg, Arena *scratch){
+    ChanJob *cj = (ChanJob*)arg;
+    PresetJob *pj = cj->pj;
+    if (!render_channels(pj->in, pj->book, pj->preset, cj->c0, cj->nc, pj->x, pj->gain, scratch))
+        atomic_store(&pj->failed, 1);
+    if (atomic_fetch_sub(&pj->left, 1) != 1) return;
+    char outname[512];
+    output_name(outname, sizeof(outname), pj);
+    int ok = !atomic_load(&pj->failed) && render_write(pj->in, outname, pj->x, pj->gain);
+    if (!ok) atomic_store(&pj->failed, 1);
+    report(outname, ok, pj->latency);
+}
+
+static int submit_split(ThreadPool *pool, PresetJob *pj, uint16_t w){
+    uint16_t ch = pj->in->wi.num_channels;
+    int ntask = (ch + w - 1) / w;
+    pj->x = arena_planes(NULL, ch, pj->in->nframes);
+    pj->gain = (float*)calloc(ch, sizeof(float));
+    pj->chans = (ChanJob*)calloc((size_t)ntask, sizeof(ChanJob));
+    if (!pj->x || !pj->gain || !pj->chans){
+        arena_free_planes(NULL, pj->x, ch);
+        free(pj->gain);
+        free(pj->chans);
+        pj->x = NULL; pj->gain = NULL; pj->chans = NULL;
+        return 0;
+    }
+    atomic_store(&pj->left, ntask);
+    for (int t=0; t<ntask; t++){
+        uint16_t c0 = (uint16_t)(t * w);
+        pj->chans[t] = (ChanJob){ pj, c0, (uint16_t)(ch - c0 < w ? ch - c0 : w) };
+        /* not queued (out of memory): run it here, as a pool without
+           workers would, so the last group still writes and reports */
+        if (!pool_submit(pool, chan_job, &pj->chans[t])) chan_job(&pj->chans[t], NULL);
+    }
+    return 1;
+}
+
+int main(int argc, char **argv){
+    int streaming = 0;
+    int fixed = 0;
+    long block = 0;
+    long jobs = 1;
+    TanhMode tanh_mode = TANH_EXACT;
+    FilterMode filter_mode = FILTER_DIRECT;
+    int out_format = -1;
+    uint32_t seed = (uint32_t)time(NULL);
+    const char *preset_path = NULL;
+    const char *sock_path = NULL;
+    const char *batch_src = NULL;
+    const char *out_tmpl = "out/{name}/{preset}.wav";
+    char *preset_list = NULL;
+    const char *live_preset = NULL;
+    const char *trace_path = NULL;
+    long rate = 48000, channels = 1;
+    int in_format = WAV_PCM16;
+    static const struct option long_opts[] = {
+        { "seed",  required_argument, NULL, 'S' },
+        { "serve", required_argument, NULL, 'L' },
+        { "batch", required_argument, NULL, 'B' },
+        { "live", required_argument, NULL, 'V' },
+        { "rate", required_argument, NULL, 'R' },
+        { "channels", required_argument, NULL, 'C' },
+        { "in-format", required_argument, NULL, 'I' },
+        { "trace", required_argument, NULL, 'T' },
+        { "ftz", no_argument, NULL, 'Z' },
+        { "fixed", no_argument, NULL, 'X' },
+        { "filter", required_argument, NULL, 'F' },
+        { NULL, 0, NULL, 0 }
     };
-    int num_presets = (int)(sizeof(preset_names)/sizeof(preset_names[0]));
+    int opt;
+    while ((opt = getopt_long(argc, argv, "sb:j:t:f:p:P:o:", long_opts, NULL)) != -1){
+        switch (opt){
+            case 's': streaming = 1; break;
+            case 'b': block = strtol(optarg, NULL, 10); break;
+            case 'j': jobs = strtol(optarg, NULL, 10); break;
+            case 't':
+                if (strcmp(optarg, "fast") == 0) tanh_mode = TANH_FAST;
+                else if (strcmp(optarg, "exact") == 0) tanh_mode = TANH_EXACT;
+                else { usage(argv[0]); return 1; }
+                break;
+            case 'f':
+                if ((out_format = parse_format(optarg)) < 0){ usage(argv[0]); return 1; }
+                break;
+            case 'I':
+                if ((in_format = parse_format(optarg)) < 0){ usage(argv[0]); return 1; }
+                break;
+            case 'p': preset_path = optarg; break;
+            case 'S': seed = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case 'L': sock_path = optarg; break;
+            case 'B': batch_src = optarg; break;
+            case 'P': preset_list = optarg; break;
+            case 'o': out_tmpl = optarg; break;
+            case 'V': live_preset = optarg; break;
+            case 'R': rate = strtol(optarg, NULL, 10); break;
+            case 'C': channels = strtol(optarg, NULL, 10); break;
+            case 'T': trace_path = optarg; break;
+            case 'Z': fpmode_set_ftz(1); break;
+            case 'X': fixed = 1; break;
+            case 'F':
+                if (strcmp(optarg, "block4") == 0) filter_mode = FILTER_BLOCK4;
+                else if (strcmp(optarg, "direct") == 0) filter_mode = FILTER_DIRECT;
+                else { usage(argv[0]); return 1; }
+                break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    /* live blocks are small: they bound the added latency */
+    if (!block) block = live_preset ? 256 : 4096;
+    if ((!sock_path && !batch_src && !live_preset && optind >= argc) || block < 1 || block > (1L<<24)
+        || jobs < 0 || jobs > 1024 || rate < 1 || rate > 1000000 || channels < 1 || channels > 64){
+        usage(argv[0]);
+        return 1;
+    }
+    if (trace_path && !PROFILE){
+        fprintf(stderr, "--trace faqat PROFILE=1 bilan yig'ilgan dasturda ishlaydi\n");
+        return 1;
+    }
+    if (!fpmode_apply()) fprintf(stderr, "--ftz bu protsessorda qo'llab-quvvatlanmaydi, e'tiborsiz qoldirildi\n");
+    if (jobs == 0) jobs = pool_default_threads();
 
-    MKDIR_P("out");
+    PresetBook book;
+    if (!preset_book_init(&book)){ fprintf(stderr,"Xotira ajratishda xatolik.\n"); return 1; }
+    int bad_line = 0;
+    if (preset_path && !preset_book_load_file(&book, preset_path, &bad_line)){
+        if (bad_line) fprintf(stderr,"Presetlar faylida xatolik: %s, %d-qator\n", preset_path, bad_line);
+        else fprintf(stderr,"Presetlar faylini o'qishda xatolik: %s\n", preset_path);
+        preset_book_free(&book);
+        return 1;
+    }
 
-    for (int pi=0; pi<num_presets; pi++){
-        Preset preset = parse_preset(preset_names[pi]);
+    int *sel = (int*)malloc((size_t)book.n * sizeof(int));
+    const char *bad = NULL;
+    int nsel = sel ? preset_book_select(&book, preset_list, sel, &bad) : -1;
+    if (nsel <= 0){
+        if (bad) fprintf(stderr,"Noma'lum preset: %s\n", bad);
+        else fprintf(stderr,"Xotira ajratishda xatolik.\n");
+        free(sel); preset_book_free(&book);
+        return 1;
+    }
 
-        float *buf = (float*)malloc(sizeof(float)*nframes*wi.num_channels);
-        memcpy(buf, buf_orig, sizeof(float)*nframes*wi.num_channels);
+    RenderOptions ro;
+    ro.block = (uint32_t)block;
+    ro.seed = seed;
+    ro.tanh_mode = tanh_mode;
+    ro.filter_mode = filter_mode;
+    ro.out_format = out_format;
+    ro.streaming = streaming;
+    ro.fixed = fixed;
 
-        float *L = (float*)malloc(sizeof(float)*nframes);
-        float *R = (wi.num_channels==2) ? (float*)malloc(sizeof(float)*nframes) : NULL;
-        split_interleaved_to_planar(buf,L,R,nframes,wi.num_channels);
+    if (sock_path){
+        printf("Tinglanmoqda: %s (%ld ishchi)\n", sock_path, jobs);
+        fflush(stdout);
+        int ok = serve(sock_path, &book, &ro, (int)jobs);
+        if (!ok) fprintf(stderr,"Soketni ochishda xatolik: %s\n", sock_path);
+        else ok = profile_done(trace_path);
+        free(sel); preset_book_free(&book);
+        return ok ? 0 : 1;
+    }
 
-        apply_preset_chain(L, nframes, (float)wi.sample_rate, preset);
-        if (wi.num_channels==2) apply_preset_chain(R, nframes, (float)wi.sample_rate, preset);
+    if (live_preset){
+        int pi = preset_book_find(&book, live_preset);
+        if (pi < 0){
+            fprintf(stderr,"Noma'lum preset: %s\n", live_preset);
+            free(sel); preset_book_free(&book);
+            return 1;
+        }
+        LiveOptions lo;
+        lo.block = (uint32_t)block;
+        lo.rate = (uint32_t)rate;
+        lo.channels = (uint16_t)channels;
+        lo.in_format = (WavFormat)in_format;
+        int ok = live_run(&lo, &book, pi, &ro);
+        ok = profile_done(trace_path) && ok;
+        free(sel); preset_book_free(&book);
+        return ok ? 0 : 1;
+    }
 
-        join_planar_to_interleaved(buf,L,R,nframes,wi.num_channels);
+    if (batch_src){
+        BatchOptions bo;
+        bo.source = batch_src;
+        bo.output = out_tmpl;
+        bo.presets = sel;
+        bo.npresets = nsel;
+        bo.threads = (int)jobs;
+        int ok = batch_run(&bo, &book, &ro);
+        ok = profile_done(trace_path) && ok;
+        free(sel); preset_book_free(&book);
+        return ok ? 0 : 1;
+    }
 
-        char outname[512];
-        snprintf(outname,sizeof(outname),"out/%s.wav",preset_names[pi]);
+    #if BENCH
+        BenchSnapshot s0, s1;
+        bench_snapshot(&s0);
+    #endif
+
+    RenderInput in;
+    RenderStatus st = render_input_open(&in, argv[optind], &ro);
+    if (st != RENDER_OK){
+        fprintf(stderr,"%s\n", render_status_text(st));
+        free(sel); preset_book_free(&book);
+        return 1;
+    }
+
+    MKDIR_P("out");
 
-        int ok = write_wav_file(outname, buf, nframes, wi.num_channels, wi.sample_rate);
-        if (ok) printf("Chiqish %s\n", outname);
-        else fprintf(stderr,"Faylni saqlashda xatolik %s\n", outname);
+    ThreadPool *pool = pool_create(jobs > 1 ? (int)jobs : 0, render_arena_bytes(&in));
+    PresetJob  *pjobs = (PresetJob*)calloc((size_t)nsel, sizeof(PresetJob));
+    if (!pool || !pjobs){
+        fprintf(stderr,"Xotira ajratishda xatolik.\n");
+        pool_destroy(pool); free(pjobs); render_input_close(&in); free(sel); preset_book_free(&book);
+        return 1;
+    }
 
-        free(buf); free(L); if (R) free(R);
+    /* more workers than presets: the channels of each preset are spread too */
+    uint16_t ch = in.wi.num_channels;
+    uint16_t w = !streaming && jobs > nsel ? render_split_width(ch, (int)((jobs + nsel - 1) / nsel)) : ch;
+    for (int k=0; k<nsel; k++){
+        PresetJob *pj = &pjobs[k];
+        pj->in = &in;
+        pj->book = &book;
+        pj->preset = sel[k];
+        pj->latency = render_latency(&book, sel[k], in.wi.sample_rate);
+        if (w < ch && !render_uses_fixed(&in, &book, sel[k]) && submit_split(pool, pj, w)) continue;
+        if (!pool_submit(pool, render_job, pj)){
+            char outname[512];
+            output_name(outname, sizeof(outname), pj);
+            atomic_store(&pj->failed, 1);
+            report(outname, 0, 0);
+        }
+    }
+    pool_wait(pool);
+    pool_destroy(pool);
+    int failed = 0;
+    for (int k=0; k<nsel; k++){
+        failed |= atomic_load(&pjobs[k].failed);
+        arena_free_planes(NULL, pjobs[k].x, ch);
+        free(pjobs[k].gain);
+        free(pjobs[k].chans);
     }
 
-    free(buf_orig);
+    free(pjobs);
+    free(sel);
+    preset_book_free(&book);
+    render_input_close(&in);
 
     #if BENCH
         bench_snapshot(&s1);
-        bench_report_diff(&s0, &s1, "sigfx run");
+        bench_report_diff(&s0, &s1, streaming ? "sigfx run (stream)" : "sigfx run");
     #endif
-    return 0;
+    return profile_done(trace_path) && !failed ? 0 : 1;
 }
@@ -0,0 +1,614 @@
+/* sigfx-bench: times every dsp primitive and every preset chain on
+   synthetic signals and reports ns/sample, samples/s and the realtime
+   factor. Results can be written as JSON and compared with a saved run.
+
+     sigfx-bench [-o out.json|-] [-c baseline.json] [-t pct] [-r repeats]
+                 [-m ms] [-f substring] [-q]
+*/
+#include "dsp.h"
+#include "biquad_multi.h"
+#include "reverb.h"
+#include "resample.h"
+#include "presets.h"
+#include "wav.h"
+#include "fpmode.h"
+#include "fixed.h"
+
+#include <unistd.h>
+
+typedef struct {
+    float     sr;
+    uint32_t  n;
+    uint16_t  ch;
+    float   **src, **x;       /* pristine input, working copy */
+    float    *inter;
+    uint8_t  *pcm;
+    float   **out;
+    uint32_t  out_cap;
+    Biquad    bq;
+    BiquadBlock4 b4;
+    Sos       sos[SIMD_LANES];
+    Osc       lfo;
+    Rng       rng;
+    Reverb    rv;
+    Resampler rs;
+    const PresetBook *book;
+    int       preset;
+    const char *tmp_path;
+    int       silent;         /* input is a short burst, then zeros */
+    uint8_t  *ref, *fx;       /* fixed: the float path's PCM16, the engine's */
+    int       has_err, err_max;
+    double    err_rms;        /* LSB */
+} Case;
+
+typedef struct {
+    const char *name;
+    uint16_t    ch;
+    int  (*init)(Case *k);     /* once per signal, may be NULL */
+    void (*prep)(Case *k);     /* before every run, not timed */
+    void (*run)(Case *k);
+    void (*done)(Case *k);
+} Kernel;
+
+typedef struct {
+    char     name[96];
+    uint32_t rate, frames;
+    uint16_t ch;
+    double   median;
+} BaseEntry;
+
+typedef struct {
+    int         repeats;
+    double      min_ns;
+    const char *filter;
+    FILE       *json;
+    FILE       *table;
+    int         nresults;
+    BaseEntry  *base;
+    int         nbase;
+    double      threshold;
+    int         regressions, faster, missing;
+} Bench;
+
+static volatile double bench_sink;
+
+static double now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* three partials and a little noise: every stage has something to chew on */
+static void synth(float *x, uint32_t n, float sr, uint32_t seed){
+    Rng r;
+    rng_seed(&r, seed);
+    for (uint32_t i=0; i<n; i++){
+        double t = (double)i / sr;
+        x[i] = (float)(0.30 * sin(2.0 * M_PI * 220.0 * t) + 0.15 * sin(2.0 * M_PI * 1330.0 * t)
+                     + 0.08 * sin(2.0 * M_PI * 4100.0 * t)) + 0.02f * rng_normal(&r);
+    }
+}
+
+/* ---- kernels ---- */
+
+static void prep_lowpass(Case *k){ k->bq = biquad_lowpass(k->sr, 3000.0f, 0.707f); }
+static void run_biquad(Case *k){ biquad_process_inplace(k->x[0], k->n, &k->bq); }
+
+static void prep_block4(Case *k){
+    Biquad q = biquad_lowpass(k->sr, 3000.0f, 0.707f);
+    biquad_block4_init(&k->b4, &q);
+}
+static void run_block4(Case *k){ biquad_block4_process(&k->b4, k->x[0], k->n); }
+
+static void prep_sos(Case *k){
+    for (int c=0; c<SIMD_LANES; c++){
+        sos_init(&k->sos[c]);
+        sos_bandlimit(&k->sos[c], k->sr, 300.0f, 3400.0f);
+    }
+}
+static void run_sos(Case *k){ sos_process(&k->sos[0], k->x[0], k->n); }
+static void run_sos_multi(Case *k){
+    Sos *s[SIMD_LANES];
+    for (int c=0; c<k->ch; c++) s[c] = &k->sos[c];
+    sos_process_multi(k->x, k->n, s, k->ch);
+}
+
+static void run_bandlimit(Case *k){ bandlimit(k->x[0], k->n, k->sr, 300.0f, 3400.0f); }
+static void run_bandpass_boost(Case *k){ bandpass_boost(k->x[0], k->n, k->sr, 1500.0f, 1.0f, 6.0f); }
+static void run_peak_abs(Case *k){ bench_sink = peak_abs(k->x[0], k->n, 0.0f); }
+static void run_sum_squares(Case *k){ bench_sink = sum_squares(k->x[0], k->n, 0.0); }
+static void run_apply_gain(Case *k){ apply_gain(k->x[0], k->n, 0.5f); }
+static void run_peak_normalize(Case *k){ peak_normalize(k->x[0], k->n, -1.0f); }
+static void run_rms_normalize(Case *k){ rms_normalize(k->x[0], k->n, -20.0f); }
+static void run_tanh(Case *k){ soft_limiter_tanh(k->x[0], k->n, 6.0f); }
+static void run_tanh_fast(Case *k){ soft_limiter_tanh_fast(k->x[0], k->n, 6.0f); }
+static void run_ring_mod(Case *k){ ring_mod(k->x[0], k->n, k->sr, 30.0f, 0.8f); }
+static void run_tremolo(Case *k){ tremolo(k->x[0], k->n, k->sr, 5.0f, 0.5f); }
+
+static void prep_ring(Case *k){ osc_init(&k->lfo, k->sr, 30.0f, 0.0f); }
+static void run_ring_block(Case *k){ ring_mod_block(k->x[0], k->n, &k->lfo, 0.8f); }
+static void prep_trem(Case *k){ osc_init(&k->lfo, k->sr, 5.0f, 0.0f); }
+static void run_trem_block(Case *k){ tremolo_block(k->x[0], k->n, &k->lfo, 0.5f); }
+
+static void run_bitcrush(Case *k){ bitcrush(k->x[0], k->n, 8); }
+static void run_clip(Case *k){ clip_safe(k->x[0], k->n); }
+static void run_noise_snr(Case *k){ add_white_noise_snr(k->x[0], k->n, 30.0f, &k->rng); }
+static void prep_rng(Case *k){ rng_seed(&k->rng, 7); }
+static void run_noise_std(Case *k){ add_white_noise_std(k->x[0], k->n, 0.01f, &k->rng); }
+
+static void run_fused(Case *k){
+    FusedOp ops[3] = {
+        { FOP_TANH_FAST, 6.0f, NULL, NULL },
+        { FOP_BITCRUSH,  8.0f, NULL, NULL },
+        { FOP_GAIN,      0.5f, NULL, NULL }
+    };
+    fused_process(ops, 3, k->x[0], k->n);
+}
+
+static void run_resample_linear(Case *k){
+    uint32_t m = 0;
+    free(resample_linear(k->x[0], k->n, 1.5f, &m));
+}
+static void run_pitch_simple(Case *k){ pitch_shift_simple(k->x[0], k->n, k->sr, 4.0f); }
+
+static int init_poly(Case *k){
+    uint32_t L, M;
+    resample_ratio_rational(48000.0 / 44100.0, &L, &M);
+    k->out_cap = (uint32_t)((uint64_t)k->n * L / M) + 64;
+    k->out = arena_planes(NULL, 1, k->out_cap);
+    return k->out && resampler_init(&k->rs, resample_bank_get(L, M, RS_QUALITY_MEDIUM), 1, 4096, NULL);
+}
+static void prep_poly(Case *k){ resampler_reset(&k->rs); }
+static void run_poly(Case *k){
+    uint32_t used = 0;
+    resampler_process(&k->rs, k->x, k->n, &used, k->out, k->out_cap);
+}
+static void done_poly(Case *k){
+    if (k->rs.buf) resampler_free(&k->rs);
+    arena_free_planes(NULL, k->out, 1);
+}
+
+static int init_reverb(Case *k){
+    ReverbParams p;
+    memset(&p, 0, sizeof(p));
+    p.ntaps = 3;
+    p.tap_sec[0] = 0.013f; p.tap_sec[1] = 0.029f; p.tap_sec[2] = 0.041f;
+    p.tap_gain[0] = 0.5f;  p.tap_gain[1] = 0.35f; p.tap_gain[2] = 0.25f;
+    p.fdn_sec[0] = 0.0297f; p.fdn_sec[1] = 0.0371f; p.fdn_sec[2] = 0.0411f; p.fdn_sec[3] = 0.0437f;
+    p.rt60 = 2.5f;
+    p.damping = 0.3f;
+    p.wet = 0.35f;
+    return reverb_init(&k->rv, k->sr, &p, NULL);
+}
+static void prep_reverb(Case *k){ reverb_reset(&k->rv); }
+static void run_reverb(Case *k){ reverb_process(&k->rv, k->x[0], k->n); }
+static void done_reverb(Case *k){ reverb_free(&k->rv); }
+
+static int init_pcm(Case *k){
+    k->pcm = (uint8_t*)malloc((size_t)k->n * k->ch * 4);
+    if (!k->pcm) return 0;
+    wav_encode(k->pcm, k->src, WAV_PCM24, k->ch, k->n);
+    return 1;
+}
+static void done_pcm(Case *k){ free(k->pcm); }
+static void run_encode16(Case *k){ wav_encode(k->pcm, k->x, WAV_PCM16, k->ch, k->n); }
+static void run_encode24(Case *k){ wav_encode(k->pcm, k->x, WAV_PCM24, k->ch, k->n); }
+static void run_decode16(Case *k){ wav_decode(k->x, k->pcm, WAV_PCM16, k->ch, k->n); }
+static void run_decode24(Case *k){ wav_decode(k->x, k->pcm, WAV_PCM24, k->ch, k->n); }
+
+static int init_inter(Case *k){
+    k->inter = (float*)malloc(sizeof(float) * k->n * k->ch);
+    if (!k->inter) return 0;
+    join_planar_to_interleaved(k->inter, k->src, k->n, k->ch);
+    return 1;
+}
+static void run_split(Case *k){ split_interleaved_to_planar(k->inter, k->x, k->n, k->ch); }
+static void run_join(Case *k){ join_planar_to_interleaved(k->inter, k->x, k->n, k->ch); }
+static void run_write_wav(Case *k){ write_wav_file(k->tmp_path, k->inter, k->n, k->ch, (uint32_t)k->sr); }
+static void done_inter(Case *k){ free(k->inter); unlink(k->tmp_path); }
+
+/* a whole preset, chain construction included, as a render would run it */
+static void run_preset(Case *k){
+    FxChain c;
+    if (!preset_book_build(k->book, k->preset, &c, k->sr, k->ch, NULL)) return;
+    chain_set_seed(&c, 5, 0);
+    chain_process_buffer(&c, k->x, k->n);
+    chain_free(&c);
+}
+
+/* the fixed-point engine from PCM16 to PCM16, chain construction included;
+   the float chain's PCM16 output is the reference for its error */
+static int init_fixed(Case *k){
+    size_t bytes = (size_t)k->n * k->ch * 2;
+    k->pcm = (uint8_t*)malloc(bytes);
+    k->ref = (uint8_t*)malloc(bytes);
+    k->fx = (uint8_t*)malloc(bytes);
+    FxChain c;
+    if (!k->pcm || !k->ref || !k->fx || !preset_book_build(k->book, k->preset, &c, k->sr, k->ch, NULL))
+        return 0;
+    wav_encode(k->pcm, k->src, WAV_PCM16, k->ch, k->n);
+    wav_decode(k->x, k->pcm, WAV_PCM16, k->ch, k->n);
+    chain_process_buffer(&c, k->x, k->n);
+    wav_encode(k->ref, k->x, WAV_PCM16, k->ch, k->n);
+    chain_free(&c);
+    return 1;
+}
+static void run_fixed(Case *k){
+    FxChain c;
+    FixedChain f;
+    if (!preset_book_build(k->book, k->preset, &c, k->sr, k->ch, NULL)) return;
+    int ok = fixed_chain_init(&f, &c, NULL);
+    chain_free(&c);
+    if (!ok) return;
+    fixed_chain_process(&f, k->pcm, k->fx, k->n);
+    fixed_chain_free(&f);
+}
+static void done_fixed(Case *k){
+    double e = 0.0;
+    size_t n = (size_t)k->n * k->ch;
+    for (size_t i=0; k->ref && k->fx && i<n; i++){
+        int d = (int16_t)(k->ref[2*i] | k->ref[2*i+1] << 8) - (int16_t)(k->fx[2*i] | k->fx[2*i+1] << 8);
+        if (d < 0) d = -d;
+        if (d > k->err_max) k->err_max = d;
+        e += (double)d * d;
+    }
+    k->err_rms = n ? sqrt(e / n) : 0.0;
+    k->has_err = 1;
+    free(k->pcm);
+    free(k->ref);
+    free(k->fx);
+}
+
+static int preset_fixed(const PresetBook *book, int p, float sr){
+    FxChain c;
+    if (!preset_book_build(book, p, &c, sr, 1, NULL)) return 0;
+    int ok = fixed_chain_supported(&c);
+    chain_free(&c);
+    return ok;
+}
+
+static const Kernel kernels[] = {
+    { "biquad_process_inplace", 1, NULL,        prep_lowpass, run_biquad,          NULL },
+    { "biquad_block4_process",  1, NULL,        prep_block4,  run_block4,          NULL },
+    { "sos_process",            1, NULL,        prep_sos,     run_sos,             NULL },
+    { "sos_process_multi",      2, NULL,        prep_sos,     run_sos_multi,       NULL },
+    { "sos_process_multi",      4, NULL,        prep_sos,     run_sos_multi,       NULL },
+    { "bandlimit",              1, NULL,        NULL,         run_bandlimit,       NULL },
+    { "bandpass_boost",         1, NULL,        NULL,         run_bandpass_boost,  NULL },
+    { "peak_abs",               1, NULL,        NULL,         run_peak_abs,        NULL },
+    { "sum_squares",            1, NULL,        NULL,         run_sum_squares,     NULL },
+    { "apply_gain",             1, NULL,        NULL,         run_apply_gain,      NULL },
+    { "peak_normalize",         1, NULL,        NULL,         run_peak_normalize,  NULL },
+    { "rms_normalize",          1, NULL,        NULL,         run_rms_normalize,   NULL },
+    { "soft_limiter_tanh",      1, NULL,        NULL,         run_tanh,            NULL },
+    { "soft_limiter_tanh_fast", 1, NULL,        NULL,         run_tanh_fast,       NULL },
+    { "ring_mod",               1, NULL,        NULL,         run_ring_mod,        NULL },
+    { "ring_mod_block",         1, NULL,        prep_ring,    run_ring_block,      NULL },
+    { "tremolo",                1, NULL,        NULL,         run_tremolo,         NULL },
+    { "tremolo_block",          1, NULL,        prep_trem,    run_trem_block,      NULL },
+    { "bitcrush",               1, NULL,        NULL,         run_bitcrush,        NULL },
+    { "clip_safe",              1, NULL,        NULL,         run_clip,            NULL },
+    { "add_white_noise_snr",    1, NULL,        prep_rng,     run_noise_snr,       NULL },
+    { "add_white_noise_std",    1, NULL,        prep_rng,     run_noise_std,       NULL },
+    { "fused_process",          1, NULL,        NULL,         run_fused,           NULL },
+    { "resample_linear",        1, NULL,        NULL,         run_resample_linear, NULL },
+    { "pitch_shift_simple",     1, NULL,        NULL,         run_pitch_simple,    NULL },
+    { "resampler_process",      1, init_poly,   prep_poly,    run_poly,            done_poly },
+    { "reverb_process",         1, init_reverb, prep_reverb,  run_reverb,          done_reverb },
+    { "wav_encode_pcm16",       2, init_pcm,    NULL,         run_encode16,        done_pcm },
+    { "wav_encode_pcm16",       8, init_pcm,    NULL,         run_encode16,        done_pcm },
+    { "wav_encode_pcm24",       2, init_pcm,    NULL,         run_encode24,        done_pcm },
+    { "wav_encode_pcm24",       8, init_pcm,    NULL,         run_encode24,        done_pcm },
+    { "wav_decode_pcm16",       2, init_pcm,    NULL,         run_decode16,        done_pcm },
+    { "wav_decode_pcm16",       8, init_pcm,    NULL,         run_decode16,        done_pcm },
+    { "wav_decode_pcm24",       2, init_pcm,    NULL,         run_decode24,        done_pcm },
+    { "wav_decode_pcm24",       8, init_pcm,    NULL,         run_decode24,        done_pcm },
+    { "deinterleave",           2, init_inter,  NULL,         run_split,           done_inter },
+    { "deinterleave",           8, init_inter,  NULL,         run_split,           done_inter },
+    { "interleave",             2, init_inter,  NULL,         run_join,            done_inter },
+    { "interleave",             8, init_inter,  NULL,         run_join,            done_inter },
+    { "write_wav_file",         2, init_inter,  NULL,         run_write_wav,       done_inter },
+};
+
+static const Kernel preset_kernel = { NULL, 1, NULL, NULL, run_preset, NULL };
+static const Kernel fixed_kernel = { NULL, 1, init_fixed, NULL, run_fixed, done_fixed };
+
+static const uint32_t kernel_frames[] = { 256, 4096, 65536, 1048576 };
+static const float    kernel_rate = 48000.0f;
+static const float    preset_rates[] = { 16000.0f, 44100.0f, 48000.0f };
+static const float    preset_secs[] = { 0.25f, 5.0f };
+
+/* also run on a burst followed by digital silence: feedback state decays
+   toward the subnormal range there, so these should not slow down */
+static const char    *silent_kernels[] = {
+    "biquad_process_inplace", "biquad_block4_process", "sos_process", "sos_process_multi", "reverb_process"
+};
+static const uint32_t silent_frames[] = { 65536, 1048576 };
+static const float    silent_secs = 5.0f;
+
+/* ---- timing ---- */
+
+static int cmp_double(const void *a, const void *b){
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/* one run from a fresh copy of the input; only the kernel is timed */
+static double run_once(const Kernel *kn, Case *k){
+    for (uint16_t c=0; c<k->ch; c++) memcpy(k->x[c], k->src[c], sizeof(float) * k->n);
+    if (kn->prep) kn->prep(k);
+    double t0 = now_ns();
+    kn->run(k);
+    return now_ns() - t0;
+}
+
+static const BaseEntry* base_find(const Bench *b, const char *name, uint32_t rate, uint32_t frames, uint16_t ch){
+    for (int i=0; i<b->nbase; i++){
+        const BaseEntry *e = &b->base[i];
+        if (e->rate == rate && e->frames == frames && e->ch == ch && strcmp(e->name, name) == 0) return e;
+    }
+    return NULL;
+}
+
+static int bench_case(Bench *b, const char *name, const Kernel *kn, Case *k){
+    if (b->filter && !strstr(name, b->filter)) return 1;
+    k->src = arena_planes(NULL, k->ch, k->n);
+    k->x = arena_planes(NULL, k->ch, k->n);
+    int ok = k->src && k->x;
+    for (uint16_t c=0; ok && c<k->ch; c++){
+        synth(k->src[c], k->n, k->sr, 1 + c);
+        if (k->silent) memset(k->src[c] + k->n / 8, 0, sizeof(float) * (k->n - k->n / 8));
+    }
+    if (ok && kn->init) ok = kn->init(k);
+    if (!ok){
+        fprintf(stderr, "%s: setup failed\n", name);
+        if (kn->done) kn->done(k);
+        arena_free_planes(NULL, k->src, k->ch);
+        arena_free_planes(NULL, k->x, k->ch);
+        return 0;
+    }
+
+    /* first touch, then size a repeat to at least min_ns of kernel time */
+    run_once(kn, k);
+    double t = run_once(kn, k);
+    uint32_t iters = t > 0.0 ? (uint32_t)ceil(b->min_ns / t) : 1000;
+    if (iters < 1) iters = 1;
+    for (uint32_t i=0; i<iters; i++) run_once(kn, k);
+
+    double per[b->repeats];
+    double samples = (double)iters * k->n * k->ch;
+    for (int r=0; r<b->repeats; r++){
+        double sum = 0.0;
+        for (uint32_t i=0; i<iters; i++) sum += run_once(kn, k);
+        per[r] = sum / samples;
+    }
+    if (kn->done) kn->done(k);
+    arena_free_planes(NULL, k->src, k->ch);
+    arena_free_planes(NULL, k->x, k->ch);
+
+    double mean = 0.0, var = 0.0;
+    for (int r=0; r<b->repeats; r++) mean += per[r];
+    mean /= b->repeats;
+    for (int r=0; r<b->repeats; r++) var += (per[r] - mean) * (per[r] - mean);
+    double sd = b->repeats > 1 ? sqrt(var / (b->repeats - 1)) : 0.0;
+    qsort(per, (size_t)b->repeats, sizeof(double), cmp_double);
+    double med = b->repeats & 1 ? per[b->repeats / 2] : 0.5 * (per[b->repeats/2 - 1] + per[b->repeats/2]);
+    double sps = 1e9 / med;
+    double rtf = sps / ((double)k->sr * k->ch);
+    uint32_t rate = (uint32_t)k->sr;
+
+    fprintf(b->table, "%-32s %6u %8u %2u %10.3f %6.1f%% %9.2f %9.1fx",
+            name, rate, k->n, k->ch, med, 100.0 * sd / mean, sps / 1e6, rtf);
+    if (b->base){
+        const BaseEntry *e = base_find(b, name, rate, k->n, k->ch);
+        if (!e){
+            fprintf(b->table, "      new");
+            b->missing++;
+        } else {
+            double d = med / e->median - 1.0;
+            fprintf(b->table, " %+7.1f%%", 100.0 * d);
+            if (d > b->threshold){ fprintf(b->table, " REGRESSION"); b->regressions++; }
+            else if (d < -b->threshold){ fprintf(b->table, " faster"); b->faster++; }
+        }
+    }
+    if (k->has_err) fprintf(b->table, "  vs float: max %d LSB, rms %.3f", k->err_max, k->err_rms);
+    fputc('\n', b->table);
+    fflush(b->table);
+
+    if (b->json){
+        fprintf(b->json, "%s    {\"name\":\"%s\",\"rate\":%u,\"frames\":%u,\"channels\":%u,\"iters\":%u,"
+                         "\"ns_per_sample\":{\"median\":%.4f,\"min\":%.4f,\"mean\":%.4f,\"stddev\":%.4f},"
+                         "\"samples_per_sec\":%.1f,\"realtime\":%.2f",
+                b->nresults ? ",\n" : "", name, rate, k->n, k->ch, iters,
+                med, per[0], mean, sd, sps, rtf);
+        if (k->has_err) fprintf(b->json, ",\"err_max_lsb\":%d,\"err_rms_lsb\":%.4f", k->err_max, k->err_rms);
+        fputc('}', b->json);
+    }
+    b->nresults++;
+    return 1;
+}
+
+/* reads back what bench_case() writes: one result object per line */
+static int load_baseline(Bench *b, const char *path){
+    FILE *f = fopen(path, "r");
+    if (!f) return 0;
+    char *line = NULL;
+    size_t cap = 0;
+    int n = 0, ok = 1;
+    while (ok && getline(&line, &cap, f) > 0){
+        BaseEntry e;
+        const char *p = strstr(line, "{\"name\":\"");
+        const char *m = strstr(line, "\"median\":");
+        if (!p || !m) continue;
+        if (sscanf(p, "{\"name\":\"%95[^\"]\",\"rate\":%u,\"frames\":%u,\"channels\":%hu",
+                   e.name, &e.rate, &e.frames, &e.ch) != 4) continue;
+        e.median = strtod(m + 9, NULL);
+        if (e.median <= 0.0) continue;
+        if (b->nbase == n){
+            n = n ? n * 2 : 128;
+            BaseEntry *v = (BaseEntry*)realloc(b->base, (size_t)n * sizeof(*v));
+            if (!v){ ok = 0; break; }
+            b->base = v;
+        }
+        b->base[b->nbase++] = e;
+    }
+    free(line);
+    fclose(f);
+    return ok && b->nbase > 0;
+}
+
+static void usage(const char *argv0){
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -o FILE   write results as JSON (- for stdout)\n"
+        "  -c FILE   compare with a saved JSON run, exit 1 on regressions\n"
+        "  -t PCT    median slowdown that counts as a regression (default 10)\n"
+        "  -r N      timed repeats per case (default 5)\n"
+        "  -m MS     minimum kernel time per repeat (default 20)\n"
+        "  -f TEXT   only cases whose name contains TEXT\n"
+        "  -q        quick: 3 repeats of 5 ms\n"
+        "  -z        flush-to-zero/denormals-are-zero (as sigfx --ftz)\n", argv0);
+}
+
+int main(int argc, char **argv){
+    Bench b;
+    memset(&b, 0, sizeof(b));
+    b.repeats = 5;
+    b.min_ns = 20e6;
+    b.threshold = 0.10;
+    b.table = stdout;
+    const char *json_path = NULL, *base_path = NULL;
+
+    for (int i=1; i<argc; i++){
+        const char *a = argv[i];
+        const char *v = i + 1 < argc ? argv[i+1] : NULL;
+        if (strcmp(a, "-q") == 0){ b.repeats = 3; b.min_ns = 5e6; continue; }
+        if (strcmp(a, "-z") == 0){ fpmode_set_ftz(1); continue; }
+        if (!v || a[0] != '-' || !a[1] || a[2]){ usage(argv[0]); return 2; }
+        i++;
+        switch (a[1]){
+            case 'o': json_path = v; break;
+            case 'c': base_path = v; break;
+            case 't': b.threshold = atof(v) / 100.0; break;
+            case 'r': b.repeats = atoi(v); break;
+            case 'm': b.min_ns = atof(v) * 1e6; break;
+            case 'f': b.filter = v; break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (b.repeats < 1 || b.repeats > 1000 || b.min_ns < 0.0 || b.threshold <= 0.0){
+        usage(argv[0]);
+        return 2;
+    }
+    if (!fpmode_apply()) fprintf(stderr, "-z: not supported on this CPU, ignored\n");
+    if (base_path && !load_baseline(&b, base_path)){
+        fprintf(stderr, "cannot read baseline %s\n", base_path);
+        return 2;
+    }
+    if (json_path){
+        if (strcmp(json_path, "-") == 0){ b.json = stdout; b.table = stderr; }
+        else if (!(b.json = fopen(json_path, "w"))){
+            fprintf(stderr, "cannot write %s\n", json_path);
+            free(b.base);
+            return 2;
+        }
+        fprintf(b.json, "{\n  \"tool\": \"sigfx-bench\",\n  \"version\": 1,\n  \"simd\": %d,\n  \"ftz\": %d,\n"
+                        "  \"repeats\": %d,\n  \"min_ms\": %.1f,\n  \"results\": [\n",
+                SIMD_VEC, fpmode_ftz(), b.repeats, b.min_ns / 1e6);
+    }
+
+    PresetBook book;
+    if (!preset_book_init(&book)){
+        fprintf(stderr, "out of memory\n");
+        return 2;
+    }
+    char tmp_path[512];
+    const char *tmpdir = getenv("TMPDIR");
+    snprintf(tmp_path, sizeof(tmp_path), "%s/sigfx-bench-%d.wav", tmpdir ? tmpdir : "/tmp", (int)getpid());
+
+    fprintf(b.table, "%-32s %6s %8s %2s %10s %7s %9s %10s%s\n", "case", "rate", "frames", "ch",
+            "ns/sample", "+-", "Msmp/s", "realtime", b.base ? "  vs base" : "");
+    int ok = 1;
+    for (size_t i=0; i<sizeof(kernels)/sizeof(kernels[0]); i++){
+        for (size_t j=0; j<sizeof(kernel_frames)/sizeof(kernel_frames[0]); j++){
+            Case k;
+            memset(&k, 0, sizeof(k));
+            k.sr = kernel_rate;
+            k.n = kernel_frames[j];
+            k.ch = kernels[i].ch;
+            k.tmp_path = tmp_path;
+            ok &= bench_case(&b, kernels[i].name, &kernels[i], &k);
+        }
+    }
+    for (size_t i=0; i<sizeof(kernels)/sizeof(kernels[0]); i++){
+        int tail = 0;
+        for (size_t j=0; j<sizeof(silent_kernels)/sizeof(silent_kernels[0]); j++)
+            tail |= strcmp(kernels[i].name, silent_kernels[j]) == 0;
+        if (!tail) continue;
+        char name[96];
+        snprintf(name, sizeof(name), "%s:silence", kernels[i].name);
+        for (size_t j=0; j<sizeof(silent_frames)/sizeof(silent_frames[0]); j++){
+            Case k;
+            memset(&k, 0, sizeof(k));
+            k.sr = kernel_rate;
+            k.n = silent_frames[j];
+            k.ch = kernels[i].ch;
+            k.silent = 1;
+            ok &= bench_case(&b, name, &kernels[i], &k);
+        }
+    }
+    for (int p=0; p<book.n; p++){
+        char name[96];
+        snprintf(name, sizeof(name), "preset:%s", book.v[p].name);
+        for (size_t r=0; r<sizeof(preset_rates)/sizeof(preset_rates[0]); r++){
+            for (size_t s=0; s<sizeof(preset_secs)/sizeof(preset_secs[0]); s++){
+                Case k;
+                memset(&k, 0, sizeof(k));
+                k.sr = preset_rates[r];
+                k.n = (uint32_t)(preset_rates[r] * preset_secs[s]);
+                k.ch = preset_kernel.ch;
+                k.book = &book;
+                k.preset = p;
+                ok &= bench_case(&b, name, &preset_kernel, &k);
+            }
+        }
+        for (size_t r=0; r<sizeof(preset_rates)/sizeof(preset_rates[0]); r++){
+            if (!preset_fixed(&book, p, preset_rates[r])) continue;
+            snprintf(name, sizeof(name), "fixed:%s", book.v[p].name);
+            for (size_t s=0; s<sizeof(preset_secs)/sizeof(preset_secs[0]); s++){
+                for (uint16_t ch=1; ch<=2; ch++){
+                    Case k;
+                    memset(&k, 0, sizeof(k));
+                    k.sr = preset_rates[r];
+                    k.n = (uint32_t)(preset_rates[r] * preset_secs[s]);
+                    k.ch = ch;
+                    k.book = &book;
+                    k.preset = p;
+                    ok &= bench_case(&b, name, &fixed_kernel, &k);
+                }
+            }
+        }
+        Case k;
+        memset(&k, 0, sizeof(k));
+        k.sr = kernel_rate;
+        k.n = (uint32_t)(kernel_rate * silent_secs);
+        k.ch = preset_kernel.ch;
+        k.book = &book;
+        k.preset = p;
+        k.silent = 1;
+        snprintf(name, sizeof(name), "preset:%s:silence", book.v[p].name);
+        ok &= bench_case(&b, name, &preset_kernel, &k);
+    }
+
+    if (b.json){
+        fprintf(b.json, "\n  ]\n}\n");
+        if (b.json != stdout) fclose(b.json);
+    }
+    if (b.base)
+        fprintf(b.table, "vs %s: %d regressed, %d faster (threshold %.0f%%), %d not in baseline\n",
+                base_path, b.regressions, b.faster, 100.0 * b.threshold, b.missing);
+    preset_book_free(&book);
+    free(b.base);
+    if (!ok) return 2;
+    return b.regressions ? 1 : 0;
+}
@@ -0,0 +1,71 @@
+#include "osc.h"
+#include "simd.h"
+
+static void osc_anchor(Osc *o){
+    double ph = fmod(o->phase0 + (double)o->i * o->dph, 2.0*M_PI);
+    uint64_t q = o->i & ~(uint64_t)3;
+    double base = ph - (double)(o->i - q) * o->dph;
+    for (int k=0;k<4;k++){
+        o->qr[k] = (float)cos(base + k*o->dph);
+        o->qi[k] = (float)sin(base + k*o->dph);
+    }
+}
+
+void osc_init(Osc *o, float sr, float f_hz, float phase){
+    memset(o,0,sizeof(*o));
+    o->phase0 = phase;
+    o->dph = 2.0*M_PI*(double)f_hz/(double)sr;
+    o->wr = (float)cos(4.0*o->dph);
+    o->wi = (float)sin(4.0*o->dph);
+    osc_anchor(o);
+}
+
+void osc_reset(Osc *o){
+    o->i = 0;
+    osc_anchor(o);
+}
+
+static inline void osc_rotate(Osc *o){
+    if (((o->i) % OSC_RESYNC) == 0){ osc_anchor(o); return; }
+    for (int k=0;k<4;k++){
+        float r = o->qr[k]*o->wr - o->qi[k]*o->wi;
+        float m = o->qr[k]*o->wi + o->qi[k]*o->wr;
+        o->qr[k] = r; o->qi[k] = m;
+    }
+}
+
+void osc_sin_block(Osc *o, float *out, uint32_t n){
+    uint32_t i = 0;
+    /* unaligned head: finish the current quad */
+    while (i < n && (o->i & 3)){
+        out[i++] = o->qi[o->i & 3];
+        if ((++o->i & 3) == 0) osc_rotate(o);
+    }
+#if SIMD_VEC
+    v4sf qr, qi, wr = o->wr + (v4sf){0}, wi = o->wi + (v4sf){0};
+    memcpy(&qr, o->qr, 16); memcpy(&qi, o->qi, 16);
+    while (i + 4 <= n){
+        memcpy(out + i, &qi, 16);
+        i += 4; o->i += 4;
+        if ((o->i % OSC_RESYNC) == 0){
+            osc_anchor(o);
+            memcpy(&qr, o->qr, 16); memcpy(&qi, o->qi, 16);
+        } else {
+            v4sf r = qr*wr - qi*wi;
+            qi = qr*wi + qi*wr;
+            qr = r;
+        }
+    }
+    memcpy(o->qr, &qr, 16); memcpy(o->qi, &qi, 16);
+#else
+    while (i + 4 <= n){
+        for (int k=0;k<4;k++) out[i+k] = o->qi[k];
+        i += 4; o->i += 4;
+        osc_rotate(o);
+    }
+#endif
+    while (i < n){
+        out[i++] = o->qi[o->i & 3];
+        if ((++o->i & 3) == 0) osc_rotate(o);
+    }
+}
@@ -0,0 +1,236 @@
+#include "pitch.h"
+#include "simd.h"
+
+static uint32_t grain_len(float sr){
+    uint32_t g = 256;
+    while ((float)g < 0.04f*sr) g <<= 1;
+    return g;
+}
+
+static float clamp_ratio(float ratio){
+    if (ratio < PITCH_RATIO_MIN) return PITCH_RATIO_MIN;
+    if (ratio > PITCH_RATIO_MAX) return PITCH_RATIO_MAX;
+    return ratio;
+}
+
+/* nominal delay at the centre of a grain; keeps every read of every
+   candidate grain at least 3 samples behind the write position */
+uint32_t pitch_shifter_latency(float sr, float ratio){
+    ratio = clamp_ratio(ratio);
+    uint32_t G = grain_len(sr);
+    double sweep = fabs(1.0 - (double)ratio) * (double)G * 0.5;
+    return G/8 + G/4 + 4 + (uint32_t)ceil(sweep);
+}
+
+int pitch_shifter_init(PitchShifter *p, float sr, float ratio, Arena *mem){
+    memset(p,0,sizeof(*p));
+    p->mem = mem;
+    ratio = clamp_ratio(ratio);
+    p->ratio = ratio;
+    p->step_i = (uint32_t)ratio;
+    p->step_f = ratio - (float)p->step_i;
+    p->G = grain_len(sr);
+    p->H = p->G/2;
+    p->S = p->G/8;
+    p->W = p->G/4;
+    p->latency = pitch_shifter_latency(sr, ratio);
+
+    uint32_t need = 2*p->latency + 2*p->G + 8, size = 1;
+    while (size < need) size <<= 1;
+    p->mask = size - 1;
+    p->buf = (float*)arena_alloc(mem, sizeof(float)*size);
+    p->win = (float*)arena_alloc(mem, sizeof(float)*p->G);
+    p->ref = (float*)arena_alloc(mem, sizeof(float)*(p->W + p->W/4));
+    p->reg = (float*)arena_alloc(mem, sizeof(float)*(2*p->S + p->W)*2);
+    if (!p->buf || !p->win || !p->ref || !p->reg){ pitch_shifter_free(p); return 0; }
+    for (uint32_t i=0;i<p->G;i++)
+        p->win[i] = (float)(0.5 - 0.5*cos(2.0*M_PI*(double)i/(double)p->G));
+    pitch_shifter_reset(p);
+    return 1;
+}
+
+void pitch_shifter_reset(PitchShifter *p){
+    if (p->buf) memset(p->buf, 0, sizeof(float)*(p->mask + 1));
+    p->t = 0;
+    p->ph = 0;
+    p->ia = p->ib = 0;
+    p->fa = p->fb = 0.0f;
+}
+
+void pitch_shifter_free(PitchShifter *p){
+    arena_free(p->mem, p->buf); arena_free(p->mem, p->win);
+    arena_free(p->mem, p->ref); arena_free(p->mem, p->reg);
+    p->buf = p->win = p->ref = p->reg = NULL;
+}
+
+static inline float ring_cubic(const float *b, uint32_t m, int64_t i, float f){
+    float xm = b[(uint64_t)(i-1) & m], x0 = b[(uint64_t)i & m];
+    float x1 = b[(uint64_t)(i+1) & m], x2 = b[(uint64_t)(i+2) & m];
+    float c1 = 0.5f*(x1 - xm);
+    float c2 = xm - 2.5f*x0 + 2.0f*x1 - 0.5f*x2;
+    float c3 = 0.5f*(x2 - xm) + 1.5f*(x0 - x1);
+    return ((c3*f + c2)*f + c1)*f + x0;
+}
+
+static void ring_copy(const PitchShifter *p, float *dst, int64_t from, uint32_t n){
+    const float *b = p->buf;
+    const uint32_t m = p->mask;
+    for (uint32_t k=0;k<n;k++) dst[k] = b[(uint64_t)(from + k) & m];
+}
+
+static void decimate4(float *dst, const float *src, uint32_t n){
+    for (uint32_t k=0;k<n;k++) dst[k] = src[4*k];
+}
+
+/* <a, b> / |b| over n samples */
+static float ncc_score(const float *a, const float *b, uint32_t n){
+    float cs = 0.0f, es = 0.0f;
+    uint32_t k = 0;
+#if SIMD_VEC
+    v4sf c = {0}, e = {0};
+    for (; k+4<=n; k+=4){
+        v4sf va, vb;
+        memcpy(&va, a+k, 16); memcpy(&vb, b+k, 16);
+        c += va*vb; e += vb*vb;
+    }
+    cs = (c[0]+c[1])+(c[2]+c[3]); es = (e[0]+e[1])+(e[2]+e[3]);
+#endif
+    for (; k<n; k++){ cs += a[k]*b[k]; es += b[k]*b[k]; }
+    return cs / sqrtf(es + 1e-9f);
+}
+
+/* read position of a grain starting now: nominal delay at its centre is
+   `latency`, refined by a coarse-then-fine search for the best match with
+   what the outgoing grain reads next */
+static double grain_start(PitchShifter *p){
+    double nominal = (double)p->t - (double)p->latency + (1.0 - (double)p->ratio)*(double)p->H;
+    int64_t base = (int64_t)floor(nominal) - (int64_t)p->S;
+    uint32_t span = 2*p->S;
+
+    uint32_t nreg = span + p->W, w4 = p->W/4;
+    float *ref4 = p->ref + p->W, *reg4 = p->reg + nreg;
+    ring_copy(p, p->ref, p->ib, p->W);
+    ring_copy(p, p->reg, base, nreg);
+    decimate4(ref4, p->ref, w4);
+    decimate4(reg4, p->reg, nreg/4);
+
+    /* offsets are multiples of 4 here, so both sides stay decimated */
+    uint32_t best = p->S;
+    float best_s = ncc_score(ref4, reg4 + best/4, w4);
+    for (uint32_t off=0; off<=span; off+=4){
+        float s = ncc_score(ref4, reg4 + off/4, w4);
+        if (s > best_s){ best_s = s; best = off; }
+    }
+    uint32_t lo = best >= 3 ? best - 3 : 0, hi = best + 3 <= span ? best + 3 : span;
+    uint32_t coarse = best;
+    best_s = ncc_score(p->ref, p->reg + coarse, p->W);
+    for (uint32_t off=lo; off<=hi; off++){
+        float s = ncc_score(p->ref, p->reg + off, p->W);
+        if (s > best_s){ best_s = s; best = off; }
+    }
+    return nominal + ((double)best - (double)p->S);
+}
+
+void pitch_shifter_process(PitchShifter *p, float *x, uint32_t n){
+    const float *wa = p->win + p->H, *wb = p->win;
+    uint32_t i = 0;
+    while (i < n){
+        if (p->ph == 0){
+            double next = grain_start(p), fl = floor(next);
+            p->ia = p->ib; p->fa = p->fb;
+            p->ib = (int64_t)fl;
+            p->fb = (float)(next - fl);
+        }
+        uint32_t k = p->H - p->ph;
+        if (k > n - i) k = n - i;
+        /* state in locals: stores through x may alias the struct */
+        float *buf = p->buf;
+        const uint32_t m = p->mask, si = p->step_i;
+        const float sf = p->step_f;
+        const float *ga = wa + p->ph, *gb = wb + p->ph;
+        int64_t t = p->t, ia = p->ia, ib = p->ib;
+        float fa = p->fa, fb = p->fb;
+        for (uint32_t j=0;j<k;j++){
+            buf[(uint64_t)t & m] = x[i+j];
+            t++;
+            x[i+j] = ga[j]*ring_cubic(buf, m, ia, fa) + gb[j]*ring_cubic(buf, m, ib, fb);
+            fa += sf; ia += si;
+            if (fa >= 1.0f){ fa -= 1.0f; ia++; }
+            fb += sf; ib += si;
+            if (fb >= 1.0f){ fb -= 1.0f; ib++; }
+        }
+        p->t = t; p->ia = ia; p->ib = ib; p->fa = fa; p->fb = fb;
+        p->ph += k;
+        if (p->ph == p->H) p->ph = 0;
+        i += k;
+    }
+}
+
+static void ps_fill(PitchSource *p, float **dst, uint32_t count){
+    uint16_t nch = p->base.nch;
+    uint32_t got = 0;
+    while (!p->eof && got < count){
+        float *d[nch];
+        for (uint16_t c=0;c<nch;c++) d[c] = dst[c] + got;
+        uint32_t r = p->up->read(p->up, d, count - got);
+        if (!r) p->eof = 1;
+        got += r;
+    }
+    for (uint16_t c=0;c<nch;c++){
+        if (got < count) memset(dst[c] + got, 0, sizeof(float)*(count - got));
+        pitch_shifter_process(&p->ps[c], dst[c], count);
+    }
+}
+
+static uint32_t ps_read(FxSource *s, float **dst, uint32_t count){
+    PitchSource *p = (PitchSource*)s;
+    while (p->skip){
+        uint32_t k = p->skip < p->chunk ? p->skip : p->chunk;
+        ps_fill(p, p->tmp, k);
+        p->skip -= k;
+    }
+    if (!p->live && count > s->length - p->pos) count = s->length - p->pos;
+    ps_fill(p, dst, count);
+    p->pos += count;
+    return count;
+}
+
+static void ps_rewind(FxSource *s){
+    PitchSource *p = (PitchSource*)s;
+    p->up->rewind(p->up);
+    for (uint16_t c=0;c<s->nch;c++) pitch_shifter_reset(&p->ps[c]);
+    p->skip = p->live ? 0 : p->ps[0].latency;
+    p->pos = 0;
+    p->eof = 0;
+}
+
+int pitch_source_init(PitchSource *p, FxSource *up, float sr, float ratio, uint32_t block,
+                      Arena *mem){
+    memset(p,0,sizeof(*p));
+    p->mem = mem;
+    p->base.read = ps_read;
+    p->base.rewind = ps_rewind;
+    p->base.length = up->length;
+    p->base.nch = up->nch;
+    p->up = up;
+    p->chunk = block;
+    p->ps = (PitchShifter*)arena_calloc(mem, up->nch, sizeof(PitchShifter));
+    p->tmp = arena_planes(mem, up->nch, block);
+    if (!p->ps || !p->tmp){ pitch_source_free(p); return 0; }
+    for (uint16_t c=0;c<up->nch;c++)
+        if (!pitch_shifter_init(&p->ps[c], sr, ratio, mem)){ pitch_source_free(p); return 0; }
+    p->skip = p->ps[0].latency;
+    return 1;
+}
+
+void pitch_source_set_live(PitchSource *p){
+    p->live = 1;
+    p->skip = 0;
+}
+
+void pitch_source_free(PitchSource *p){
+    if (p->ps) for (uint16_t c=0;c<p->base.nch;c++) pitch_shifter_free(&p->ps[c]);
+    arena_free_planes(p->mem, p->tmp, p->base.nch);
+    arena_free(p->mem, p->ps);
+    p->ps = NULL; p->tmp = NULL;
+}
@@ -0,0 +1,125 @@
+#include "pool.h"
+#include "fpmode.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+typedef struct PoolJob {
+    PoolFn fn;
+    void  *arg;
+    struct PoolJob *next;
+} PoolJob;
+
+struct ThreadPool {
+    pthread_mutex_t mu;
+    pthread_cond_t  has_job, idle;
+    PoolJob        *head, *tail;
+    int             pending;     /* queued or running */
+    int             queued;
+    int             stop;
+    int             nthreads;
+    pthread_t      *threads;
+    Arena          *arenas;      /* one per worker; [0] also serves inline jobs */
+    int             narenas, next_arena;
+};
+
+static void* pool_worker(void *arg){
+    ThreadPool *p = (ThreadPool*)arg;
+    pthread_mutex_lock(&p->mu);
+    Arena *scratch = &p->arenas[p->next_arena++];
+    fpmode_apply();
+    for (;;){
+        while (!p->head && !p->stop) pthread_cond_wait(&p->has_job, &p->mu);
+        if (!p->head) break;
+        PoolJob *j = p->head;
+        p->head = j->next;
+        if (!p->head) p->tail = NULL;
+        p->queued--;
+        pthread_mutex_unlock(&p->mu);
+
+        arena_reset(scratch);
+        j->fn(j->arg, scratch);
+        free(j);
+
+        pthread_mutex_lock(&p->mu);
+        if (--p->pending == 0) pthread_cond_broadcast(&p->idle);
+    }
+    pthread_mutex_unlock(&p->mu);
+    return NULL;
+}
+
+ThreadPool* pool_create(int nthreads, size_t arena_bytes){
+    ThreadPool *p = (ThreadPool*)calloc(1, sizeof(*p));
+    if (!p) return NULL;
+    pthread_mutex_init(&p->mu, NULL);
+    pthread_cond_init(&p->has_job, NULL);
+    pthread_cond_init(&p->idle, NULL);
+    if (nthreads < 0) nthreads = 0;
+    p->narenas = nthreads ? nthreads : 1;
+    p->arenas = (Arena*)calloc((size_t)p->narenas, sizeof(Arena));
+    if (!p->arenas){ pool_destroy(p); return NULL; }
+    for (int i=0;i<p->narenas;i++)
+        if (!arena_init(&p->arenas[i], arena_bytes)){ pool_destroy(p); return NULL; }
+    if (nthreads){
+        p->threads = (pthread_t*)calloc((size_t)nthreads, sizeof(pthread_t));
+        if (!p->threads){ pool_destroy(p); return NULL; }
+    }
+    for (int i=0;i<nthreads;i++){
+        if (pthread_create(&p->threads[i], NULL, pool_worker, p) != 0) break;
+        p->nthreads++;
+    }
+    return p;
+}
+
+int pool_submit(ThreadPool *p, PoolFn fn, void *arg){
+    if (!p->nthreads){
+        arena_reset(&p->arenas[0]);
+        fn(arg, &p->arenas[0]);
+        return 1;
+    }
+    PoolJob *j = (PoolJob*)malloc(sizeof(*j));
+    if (!j) return 0;
+    j->fn = fn; j->arg = arg; j->next = NULL;
+    pthread_mutex_lock(&p->mu);
+    if (p->tail) p->tail->next = j; else p->head = j;
+    p->tail = j;
+    p->pending++;
+    p->queued++;
+    pthread_cond_signal(&p->has_job);
+    pthread_mutex_unlock(&p->mu);
+    return 1;
+}
+
+void pool_wait(ThreadPool *p){
+    pthread_mutex_lock(&p->mu);
+    while (p->pending) pthread_cond_wait(&p->idle, &p->mu);
+    pthread_mutex_unlock(&p->mu);
+}
+
+int pool_queued(ThreadPool *p){
+    pthread_mutex_lock(&p->mu);
+    int n = p->queued;
+    pthread_mutex_unlock(&p->mu);
+    return n;
+}
+
+void pool_destroy(ThreadPool *p){
+    if (!p) return;
+    pthread_mutex_lock(&p->mu);
+    p->stop = 1;
+    pthread_cond_broadcast(&p->has_job);
+    pthread_mutex_unlock(&p->mu);
+    for (int i=0;i<p->nthreads;i++) pthread_join(p->threads[i], NULL);
+    free(p->threads);
+    if (p->arenas) for (int i=0;i<p->narenas;i++) arena_destroy(&p->arenas[i]);
+    free(p->arenas);
+    pthread_mutex_destroy(&p->mu);
+    pthread_cond_destroy(&p->has_job);
+    pthread_cond_destroy(&p->idle);
+    free(p);
+}
+
+int pool_default_threads(void){
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n < 1 ? 1 : (int)n;
+}
@@ -1,5 +1,7 @@
 #include "presets.h"
 
+#include <ctype.h>
+
 Preset parse_preset(const char *s){
     if (!s) return PRESET_NONE;
     #define IS(name, val) if (strcmp(s,(name))==0) return (val)
@@ -28,188 +30,259 @@ Preset parse_preset(const char *s){
     #undef IS
 }
 
-void apply_preset_chain(float *x, uint32_t n, float sr, Preset p){
-    switch (p){
-        case PRESET_NONE: break;
-
-        case PRESET_NORMALIZE_PEAK:
-            peak_normalize(x,n,-1.0f); break;
-
-        case PRESET_NORMALIZE_RMS:
-            rms_normalize(x,n,-20.0f); break;
-
-        case PRESET_SWEETEN: {
-            Biquad hp = biquad_highpass(sr, 60.0f, 0.707f);
-            biquad_process_inplace(x,n,&hp);
-            Biquad pk = biquad_peak(sr, 3000.0f, 1.0f, 3.0f);
-            biquad_process_inplace(x,n,&pk);
-            rms_normalize(x,n,-20.0f);
-            soft_limiter_tanh(x,n,4.0f);
-            peak_normalize(x,n,-1.0f);
-        } break;
-
-        case PRESET_RADIO_VO: {
-            bandlimit(x,n,sr,90.0f,9000.0f);
-            Biquad pk = biquad_peak(sr, 1800.0f, 0.9f, 4.0f);
-            biquad_process_inplace(x,n,&pk);
-            rms_normalize(x,n,-20.0f);
-            soft_limiter_tanh(x,n,3.0f);
-            peak_normalize(x,n,-1.0f);
-        } break;
-
-        case PRESET_TELEPHONE:
-            bandlimit(x,n,sr,300.0f,3400.0f);
-            peak_normalize(x,n,-1.0f);
-            break;
-
-        case PRESET_WALKIE_TALKIE:
-            bandlimit(x,n,sr,600.0f,3000.0f);
-            bitcrush(x,n,6);
-            soft_limiter_tanh(x,n,4.0f);
-            peak_normalize(x,n,-1.0f);
-            break;
-
-        case PRESET_MEGAPHONE:
-            bandpass_boost(x,n,sr,2000.0f,0.8f,6.0f);
-            soft_limiter_tanh(x,n,10.0f);
-            peak_normalize(x,n,-1.0f);
-            break;
-
-        case PRESET_STADIUM_PA:
-            bandlimit(x,n,sr,120.0f,6500.0f);
-            add_white_noise_snr(x,n,35.0f);
-            peak_normalize(x,n,-1.0f);
-            soft_limiter_tanh(x,n,2.0f);
-            break;
-
-        case PRESET_CAVE: {
-            int d1 = (int)(0.12f*sr), d2 = (int)(0.27f*sr);
-            float *src = (float*)malloc(sizeof(float)*n); if (!src) break;
-            memcpy(src, x, sizeof(float)*n);
-            for (uint32_t i = 0; i < n; i++) {
-                if ((int)i + d1 < (int)n) x[i + d1] += 0.35f * src[i];
-                if ((int)i + d2 < (int)n) x[i + d2] += 0.22f * src[i];
-            }
-            free(src);
-            bandlimit(x,n,sr,120.0f,6000.0f);
-            peak_normalize(x,n,-1.0f);
-            soft_limiter_tanh(x,n,2.0f);
-        } break;
-
-        case PRESET_CATHEDRAL: {
-            const float delays[] = {0.15f, 0.33f, 0.51f, 0.72f};
-            const float gains [] = {0.35f, 0.25f, 0.18f, 0.12f};
-            float *src = (float*)malloc(sizeof(float)*n); if (!src) break;
-            memcpy(src, x, sizeof(float)*n);
-            for (uint32_t i=0;i<n;i++){
-                for (int k=0;k<4;k++){
-                    int d = (int)(delays[k]*sr);
-                    if ((int)i + d < (int)n) x[i + d] += gains[k] * src[i];
-                }
-            }
-            free(src);
-            bandlimit(x,n,sr,80.0f,8000.0f);
-            peak_normalize(x,n,-1.0f);
-            soft_limiter_tanh(x,n,2.0f);
-        } break;
-
-        case PRESET_UNDERWATER:
-            bandlimit(x,n,sr,100.0f,800.0f);
-            tremolo(x,n,sr,5.0f,0.4f);
-            peak_normalize(x,n,-1.0f);
-            break;
-
-        case PRESET_INTERCOM:
-            bandlimit(x,n,sr,700.0f,2800.0f);
-            soft_limiter_tanh(x,n,6.0f);
-            peak_normalize(x,n,-1.0f);
-            break;
-
-        case PRESET_VINYL_LOFI: {
-            float ny = 0.5f * sr;
-            float target = 8000.0f;
-            if (sr <= 10000.0f) target = fmaxf(1000.0f, ny * 0.6f);
-
-            uint32_t n_ds=0, n_us=0;
-            float *ds = resample_linear(x,n, target / sr, &n_ds);
-            if (!ds) break;
-            float *us = resample_linear(ds,n_ds, sr / target, &n_us);
-            free(ds);
-
-            uint32_t cpy = (n_us < n) ? n_us : n;
-            memset(x,0,sizeof(float)*n);
-            if (us) { memcpy(x,us,sizeof(float)*cpy); free(us); }
-
-            bandlimit(x,n,sr,150.0f, fminf(5000.0f, 0.5f*sr - 500.0f));
-            bitcrush(x,n,7);
-            add_white_noise_snr(x,n,28.0f);
-            peak_normalize(x,n,-1.0f);
-            soft_limiter_tanh(x,n,2.0f);
-        } break;
-
-        case PRESET_ROBOT_RINGMOD:
-            ring_mod(x,n,sr,40.0f,1.0f);
-            tremolo(x,n,sr,12.0f,0.25f);
-            peak_normalize(x,n,-1.0f);
-            soft_limiter_tanh(x,n,3.0f);
-            break;
-
-        case PRESET_ALIEN_ROBOT:
-            ring_mod(x,n,sr,70.0f,1.0f);
-            peak_normalize(x,n,-1.0f);
-            soft_limiter_tanh(x,n,2.0f);
-            break;
-
-        case PRESET_CHIPMUNK: {
-            float *buf = x; uint32_t nn = n;
-            float *tmp = (float*)malloc(sizeof(float)*nn);
-            if (tmp){ memcpy(tmp, buf, sizeof(float)*nn); x = tmp; }
-            uint32_t n2 = pitch_shift_change_duration(&x, nn, +7.0f);
-            uint32_t cpy = (n2 < n) ? n2 : n;
-            memcpy(buf, x, sizeof(float)*cpy);
-            if (n2 < n) memset(buf + cpy, 0, sizeof(float)*(n - cpy));
-            if (tmp){ free(x); }
-            peak_normalize(buf,n,-1.0f);
-            soft_limiter_tanh(buf,n,1.5f);
-            return;
-        }
+static const char *const preset_names[PRESET_COUNT] = {
+    "none","normalize_peak","normalize_rms","sweeten","radio_vo",
+    "telephone","walkie_talkie","megaphone","stadium_pa","cave",
+    "cathedral","underwater","intercom","vinyl_lofi","robot_ringmod",
+    "alien_robot","chipmunk","baritone","deep_voice","whisperish","pitch_up_fun"
+};
+
+const char *preset_name(Preset p){
+    return ((int)p >= 0 && p < PRESET_COUNT) ? preset_names[p] : "none";
+}
+
+/* built-in presets in the chainspec language, in Preset order */
+static const char *const preset_specs[PRESET_COUNT] = {
+    [PRESET_NONE] = "",
+    [PRESET_NORMALIZE_PEAK] = "peak_norm -1",
+    [PRESET_NORMALIZE_RMS] = "rms_norm -20",
+    [PRESET_SWEETEN] =
+        "highpass 60 0.707\n"
+        "peak 3000 1 3\n"
+        "rms_norm -20\n"
+        "tanh 4\n"
+        "peak_norm -1",
+    [PRESET_RADIO_VO] =
+        "bandlimit 90 9000\n"
+        "peak 1800 0.9 4\n"
+        "rms_norm -20\n"
+        "tanh 3\n"
+        "peak_norm -1",
+    [PRESET_TELEPHONE] =
+        "bandlimit 300 3400\n"
+        "peak_norm -1",
+    [PRESET_WALKIE_TALKIE] =
+        "bandlimit 600 3000\n"
+        "bitcrush 6\n"
+        "tanh 4\n"
+        "peak_norm -1",
+    [PRESET_MEGAPHONE] =
+        "bandpass_boost 2000 0.8 6\n"
+        "tanh 10\n"
+        "peak_norm -1",
+    [PRESET_STADIUM_PA] =
+        "bandlimit 120 6500\n"
+        "noise 35\n"
+        "peak_norm -1\n"
+        "tanh 2",
+    [PRESET_CAVE] =
+        "reverb 1.4 0.35 0.18  0.0297 0.0371 0.0411 0.0437  0.12 0.35  0.27 0.22\n"
+        "bandlimit 120 6000\n"
+        "peak_norm -1\n"
+        "tanh 2",
+    [PRESET_CATHEDRAL] =
+        "reverb 3.8 0.45 0.25  0.0673 0.0791 0.0899 0.1013"
+        "  0.15 0.35  0.33 0.25  0.51 0.18  0.72 0.12\n"
+        "bandlimit 80 8000\n"
+        "peak_norm -1\n"
+        "tanh 2",
+    [PRESET_UNDERWATER] =
+        "bandlimit 100 800\n"
+        "tremolo 5 0.4\n"
+        "peak_norm -1",
+    [PRESET_INTERCOM] =
+        "bandlimit 700 2800\n"
+        "tanh 6\n"
+        "peak_norm -1",
+    [PRESET_VINYL_LOFI] =
+        "decimate 8000\n"
+        "bandlimit 150 5000\n"
+        "bitcrush 7\n"
+        "noise 28\n"
+        "peak_norm -1\n"
+        "tanh 2",
+    [PRESET_ROBOT_RINGMOD] =
+        "ring_mod 40 1\n"
+        "tremolo 12 0.25\n"
+        "peak_norm -1\n"
+        "tanh 3",
+    [PRESET_ALIEN_ROBOT] =
+        "ring_mod 70 1\n"
+        "peak_norm -1\n"
+        "tanh 2",
+    [PRESET_CHIPMUNK] =
+        "pitch 7\n"
+        "peak_norm -1\n"
+        "tanh 1.5",
+    [PRESET_BARITONE] =
+        "pitch -5\n"
+        "bandlimit 80 4500\n"
+        "peak_norm -1\n"
+        "tanh 3",
+    [PRESET_DEEP_VOICE] =
+        "pitch -5\n"
+        "bandlimit 80 4500\n"
+        "peak_norm -1\n"
+        "tanh 3",
+    [PRESET_WHISPERISH] =
+        "highpass 2000 0.707\n"
+        "noise 20\n"
+        "rms_norm -22\n"
+        "clip",
+    [PRESET_PITCH_UP_FUN] =
+        "pitch 3\n"
+        "peak_norm -1\n"
+        "tanh 2",
+};
+
+static int book_build(const ChainSpec *s, const char *name, FxChain *c, float sr, uint16_t nch,
+                      Arena *mem){
+    chain_init(c, sr, nch, mem);
+    chain_set_name(c, name);
+    if (chainspec_build(s, c)) return 1;
+    chain_free(c);
+    return 0;
+}
+
+int preset_build_chain(FxChain *c, Preset p, float sr, uint16_t nch, Arena *mem){
+    ChainSpec s;
+    chainspec_init(&s);
+    if ((int)p < 0 || p >= PRESET_COUNT || !chainspec_parse(&s, preset_specs[p], NULL)) return 0;
+    return book_build(&s, preset_name(p), c, sr, nch, mem);
+}
+
+static PresetDef* book_slot(PresetBook *b, const char *name){
+    int i = preset_book_find(b, name);
+    if (i >= 0) return &b->v[i];
+    if (b->n == b->cap){
+        int cap = b->cap ? b->cap*2 : 32;
+        PresetDef *v = (PresetDef*)realloc(b->v, sizeof(PresetDef)*cap);
+        if (!v) return NULL;
+        b->v = v; b->cap = cap;
+    }
+    PresetDef *d = &b->v[b->n++];
+    snprintf(d->name, sizeof(d->name), "%s", name);
+    return d;
+}
+
+int preset_book_init(PresetBook *b){
+    memset(b,0,sizeof(*b));
+    for (int p=0; p<PRESET_COUNT; p++){
+        PresetDef *d = book_slot(b, preset_names[p]);
+        if (!d){ preset_book_free(b); return 0; }
+        chainspec_init(&d->spec);
+        if (!chainspec_parse(&d->spec, preset_specs[p], NULL)){ preset_book_free(b); return 0; }
+    }
+    return 1;
+}
+
+int preset_book_find(const PresetBook *b, const char *name){
+    for (int i=0;i<b->n;i++)
+        if (strcmp(b->v[i].name, name) == 0) return i;
+    return -1;
+}
+
+int preset_book_select(const PresetBook *b, char *list, int *sel, const char **bad){
+    int n = 0;
+    if (!list || strcmp(list, "all") == 0){
+        for (int i=0;i<b->n;i++) sel[n++] = i;
+        return n;
+    }
+    char *save = NULL;
+    for (char *name = strtok_r(list, ",", &save); name; name = strtok_r(NULL, ",", &save)){
+        int i = preset_book_find(b, name);
+        if (i < 0){ *bad = name; return -1; }
+        if (n < b->n) sel[n++] = i;
+    }
+    return n;
+}
+
+static int section_name(const char *line, char *name, size_t cap){
+    while (isspace((unsigned char)*line)) line++;
+    if (*line != '[') return 0;
+    const char *e = strchr(++line, ']');
+    size_t len = e ? (size_t)(e - line) : 0;
+    if (!len || len >= cap) return -1;
+    for (size_t i=0;i<len;i++)
+        if (!isalnum((unsigned char)line[i]) && line[i] != '_' && line[i] != '-') return -1;
+    for (e++; *e; e++)
+        if (*e == '#') break;
+        else if (!isspace((unsigned char)*e)) return -1;
+    memcpy(name, line, len);
+    name[len] = 0;
+    return 1;
+}
+
+int preset_book_load(PresetBook *b, const char *text, int *bad_line){
+    char line[512];
+    PresetDef *cur = NULL;
+    int no = 0;
+    while (*text){
+        const char *eol = strchr(text, '\n');
+        size_t len = eol ? (size_t)(eol - text) : strlen(text);
+        no++;
+        if (len >= sizeof(line)) goto bad;
+        memcpy(line, text, len);
+        line[len] = 0;
+        text += len + (eol ? 1 : 0);
 
-        case PRESET_BARITONE:
-        case PRESET_DEEP_VOICE: {
-            float *buf = x; uint32_t nn = n;
-            float *tmp = (float*)malloc(sizeof(float)*nn);
-            if (tmp){ memcpy(tmp, buf, sizeof(float)*nn); x = tmp; }
-            uint32_t n2 = pitch_shift_change_duration(&x, nn, -5.0f);
-            uint32_t cpy = (n2 < n) ? n2 : n;
-            memcpy(buf, x, sizeof(float)*cpy);
-            if (n2 < n) memset(buf + cpy, 0, sizeof(float)*(n - cpy));
-            if (tmp){ free(x); }
-            bandlimit(buf,n,sr,80.0f,4500.0f);
-            peak_normalize(buf,n,-1.0f);
-            soft_limiter_tanh(buf,n,3.0f);
-            return;
+        char name[PRESET_NAME_MAX];
+        int sec = section_name(line, name, sizeof(name));
+        if (sec < 0) goto bad;
+        if (sec > 0){
+            cur = book_slot(b, name);
+            if (!cur) goto bad;
+            chainspec_init(&cur->spec);
+        } else if (cur){
+            if (!chainspec_parse_line(&cur->spec, line)) goto bad;
+        } else {
+            /* stages before the first [name] are an error, comments are not */
+            ChainSpec probe;
+            chainspec_init(&probe);
+            if (!chainspec_parse_line(&probe, line) || probe.n) goto bad;
         }
+    }
+    return 1;
+bad:
+    if (bad_line) *bad_line = no;
+    return 0;
+}
 
-        case PRESET_WHISPERISH: {
-            Biquad hp = biquad_highpass(sr,2000.0f,0.707f);
-            biquad_process_inplace(x,n,&hp);
-            add_white_noise_snr(x,n,20.0f);
-            rms_normalize(x,n,-22.0f);
-            clip_safe(x,n);
-        } break;
-
-        case PRESET_PITCH_UP_FUN: {
-            float *buf = x; uint32_t nn = n;
-            float *tmp = (float*)malloc(sizeof(float)*nn);
-            if (tmp){ memcpy(tmp, buf, sizeof(float)*nn); x = tmp; }
-            uint32_t n2 = pitch_shift_change_duration(&x, nn, +3.0f);
-            uint32_t cpy = (n2 < n) ? n2 : n;
-            memcpy(buf, x, sizeof(float)*cpy);
-            if (n2 < n) memset(buf + cpy, 0, sizeof(float)*(n - cpy));
-            if (tmp){ free(x); }
-            peak_normalize(buf,n,-1.0f);
-            soft_limiter_tanh(buf,n,2.0f);
-            return;
+int preset_book_load_file(PresetBook *b, const char *path, int *bad_line){
+    if (bad_line) *bad_line = 0;
+    FILE *f = fopen(path, "rb");
+    if (!f) return 0;
+    size_t cap = 4096, len = 0, got;
+    char *text = (char*)malloc(cap);
+    while (text && (got = fread(text + len, 1, cap - len - 1, f)) > 0){
+        len += got;
+        if (cap - len == 1){
+            char *t = (char*)realloc(text, cap*2);
+            if (!t){ free(text); text = NULL; break; }
+            text = t; cap *= 2;
         }
     }
+    fclose(f);
+    if (!text) return 0;
+    text[len] = 0;
+    int ok = preset_book_load(b, text, bad_line);
+    free(text);
+    return ok;
+}
+
+int preset_book_build(const PresetBook *b, int i, FxChain *c, float sr, uint16_t nch, Arena *mem){
+    return book_build(&b->v[i].spec, b->v[i].name, c, sr, nch, mem);
+}
+
+void preset_book_free(PresetBook *b){
+    free(b->v);
+    memset(b,0,sizeof(*b));
+}
+
+void apply_preset_chain(float *x, uint32_t n, float sr, Preset p, uint32_t seed){
+    FxChain c;
+    if (!preset_build_chain(&c, p, sr, 1, NULL)) return;
+    chain_set_seed(&c, seed, 0);
+    chain_process_buffer(&c, &x, n);
+    chain_free(&c);
 }
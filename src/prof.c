@@ -0,0 +1,305 @@
+#include "prof.h"
+#include "bench.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROF_X86 1
+#else
+#define PROF_X86 0
+#endif
+
+enum { CTR_CYCLES, CTR_INSTR, CTR_MISSES, CTR_COUNT };
+
+typedef struct {
+    const char *name, *cat;
+    uint64_t    ts, dur;
+    uint32_t    n, tid;
+    int32_t     ch;
+} ProfEvent;
+
+typedef struct {
+    const char *preset, *name;
+    int         order, stage, ch;
+    ProfStat    st;
+} ProfEntry;
+
+static pthread_mutex_t prof_mu = PTHREAD_MUTEX_INITIALIZER;
+static char          **prof_names;
+static int             prof_nnames, prof_cap_names;
+static ProfEntry      *prof_entries;
+static int             prof_n, prof_cap;
+static const char    **prof_presets;      /* first-seen order for the report */
+static int             prof_npresets, prof_cap_presets;
+
+static pthread_once_t  prof_once = PTHREAD_ONCE_INIT;
+static uint64_t        prof_t0;
+static ProfEvent      *prof_events;
+static atomic_uint     prof_nevents;
+static atomic_int      prof_perf_ok;
+static atomic_uint     prof_threads;
+
+/* per thread: 0 unopened, 1 counters open, -1 none */
+static __thread int                          prof_state;
+static __thread uint32_t                     prof_tid;
+static __thread int                          prof_fd[CTR_COUNT];
+static __thread struct perf_event_mmap_page *prof_pc[CTR_COUNT];
+
+static uint64_t now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void prof_init(void){
+    prof_t0 = now_ns();
+    prof_events = (ProfEvent*)calloc(PROF_TRACE_MAX, sizeof(ProfEvent));
+}
+
+const char* prof_intern(const char *s){
+    if (!s) s = "chain";
+    const char *out = NULL;
+    pthread_mutex_lock(&prof_mu);
+    for (int i=0; i<prof_nnames && !out; i++)
+        if (strcmp(prof_names[i], s) == 0) out = prof_names[i];
+    if (!out && prof_nnames == prof_cap_names){
+        int cap = prof_cap_names ? prof_cap_names * 2 : 64;
+        char **v = (char**)realloc(prof_names, (size_t)cap * sizeof(char*));
+        if (v){ prof_names = v; prof_cap_names = cap; }
+    }
+    if (!out && prof_nnames < prof_cap_names && (prof_names[prof_nnames] = strdup(s)))
+        out = prof_names[prof_nnames++];
+    pthread_mutex_unlock(&prof_mu);
+    return out ? out : "?";
+}
+
+/* ---- hardware counters ---- */
+
+static int perf_open(uint64_t config, int group){
+    struct perf_event_attr a;
+    memset(&a, 0, sizeof(a));
+    a.type = PERF_TYPE_HARDWARE;
+    a.size = sizeof(a);
+    a.config = config;
+    a.exclude_kernel = 1;
+    a.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &a, 0, -1, group, 0);
+}
+
+static void counters_open(void){
+    static const uint64_t cfg[CTR_COUNT] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES
+    };
+    prof_state = -1;
+    prof_tid = atomic_fetch_add(&prof_threads, 1) + 1;
+    for (int k=0; k<CTR_COUNT; k++){ prof_fd[k] = -1; prof_pc[k] = NULL; }
+    for (int k=0; k<CTR_COUNT; k++){
+        prof_fd[k] = perf_open(cfg[k], k ? prof_fd[0] : -1);
+        if (prof_fd[k] < 0) goto fail;
+        void *pc = mmap(NULL, (size_t)sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, prof_fd[k], 0);
+        prof_pc[k] = pc == MAP_FAILED ? NULL : (struct perf_event_mmap_page*)pc;
+    }
+    prof_state = 1;
+    atomic_store(&prof_perf_ok, 1);
+    return;
+fail:
+    for (int k=0; k<CTR_COUNT; k++){
+        if (prof_pc[k]) munmap(prof_pc[k], (size_t)sysconf(_SC_PAGESIZE));
+        if (prof_fd[k] >= 0) close(prof_fd[k]);
+        prof_fd[k] = -1; prof_pc[k] = NULL;
+    }
+}
+
+/* rdpmc through the mapped page when the kernel allows it, else read() */
+static uint64_t counter_read(int k){
+#if PROF_X86
+    struct perf_event_mmap_page *pc = prof_pc[k];
+    if (pc && pc->cap_user_rdpmc){
+        uint32_t seq, idx;
+        uint64_t v;
+        do {
+            seq = pc->lock;
+            atomic_signal_fence(memory_order_seq_cst);
+            idx = pc->index;
+            v = (uint64_t)pc->offset;
+            if (idx){
+                uint16_t w = pc->pmc_width;
+                int64_t r = (int64_t)(__rdpmc((int)idx - 1) << (64 - w)) >> (64 - w);
+                v += (uint64_t)r;
+            }
+            atomic_signal_fence(memory_order_seq_cst);
+        } while (pc->lock != seq);
+        if (idx) return v;
+    }
+#endif
+    uint64_t v = 0;
+    if (read(prof_fd[k], &v, sizeof(v)) != (ssize_t)sizeof(v)) v = 0;
+    return v;
+}
+
+static uint64_t cycles_now(void){
+#if PROF_X86
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+void prof_begin(ProfMark *m){
+    pthread_once(&prof_once, prof_init);
+    if (!prof_state) counters_open();
+    if (prof_state > 0){
+        m->cycles = counter_read(CTR_CYCLES);
+        m->instr = counter_read(CTR_INSTR);
+        m->misses = counter_read(CTR_MISSES);
+    } else {
+        m->cycles = cycles_now();
+        m->instr = m->misses = 0;
+    }
+    m->ns = now_ns();
+}
+
+void prof_end(const ProfMark *m, ProfStat *st, uint32_t n, uint64_t bytes,
+              const char *name, const char *cat, int ch){
+    uint64_t t = now_ns();
+    if (prof_state > 0){
+        st->cycles += counter_read(CTR_CYCLES) - m->cycles;
+        st->instr += counter_read(CTR_INSTR) - m->instr;
+        st->misses += counter_read(CTR_MISSES) - m->misses;
+    } else {
+        st->cycles += cycles_now() - m->cycles;
+    }
+    st->ns += t - m->ns;
+    st->calls++;
+    st->samples += n;
+    st->bytes += bytes;
+
+    unsigned i = atomic_fetch_add(&prof_nevents, 1);
+    if (prof_events && i < PROF_TRACE_MAX)
+        prof_events[i] = (ProfEvent){ name, cat, m->ns - prof_t0, t - m->ns, n, prof_tid, ch };
+}
+
+void prof_add(const char *preset, int stage, const char *name, int ch, const ProfStat *st){
+    if (!st->calls) return;
+    pthread_mutex_lock(&prof_mu);
+    int order = 0;
+    while (order < prof_npresets && prof_presets[order] != preset) order++;
+    if (order == prof_npresets && prof_npresets == prof_cap_presets){
+        int cap = prof_cap_presets ? prof_cap_presets * 2 : 32;
+        const char **v = (const char**)realloc(prof_presets, (size_t)cap * sizeof(char*));
+        if (v){ prof_presets = v; prof_cap_presets = cap; }
+    }
+    if (order == prof_npresets && prof_npresets < prof_cap_presets) prof_presets[prof_npresets++] = preset;
+
+    ProfEntry *e = NULL;
+    for (int i=0; i<prof_n && !e; i++){
+        ProfEntry *x = &prof_entries[i];
+        if (x->preset == preset && x->stage == stage && x->name == name && x->ch == ch) e = x;
+    }
+    if (!e && prof_n == prof_cap){
+        int cap = prof_cap ? prof_cap * 2 : 256;
+        ProfEntry *v = (ProfEntry*)realloc(prof_entries, (size_t)cap * sizeof(*v));
+        if (v){ prof_entries = v; prof_cap = cap; }
+    }
+    if (!e && prof_n < prof_cap){
+        e = &prof_entries[prof_n++];
+        memset(e, 0, sizeof(*e));
+        e->preset = preset; e->order = order; e->stage = stage; e->name = name; e->ch = ch;
+    }
+    if (e){
+        e->st.calls += st->calls;   e->st.samples += st->samples; e->st.bytes += st->bytes;
+        e->st.ns += st->ns;         e->st.cycles += st->cycles;
+        e->st.instr += st->instr;   e->st.misses += st->misses;
+    }
+    pthread_mutex_unlock(&prof_mu);
+}
+
+static int by_stage(const void *a, const void *b){
+    const ProfEntry *x = (const ProfEntry*)a, *y = (const ProfEntry*)b;
+    if (x->order != y->order) return x->order - y->order;
+    if (x->stage != y->stage) return x->stage - y->stage;
+    int c = strcmp(x->name, y->name);
+    if (c) return c;
+    return x->ch - y->ch;
+}
+
+void prof_report(const char *label){
+    pthread_mutex_lock(&prof_mu);
+    qsort(prof_entries, (size_t)prof_n, sizeof(ProfEntry), by_stage);
+    int perf = atomic_load(&prof_perf_ok);
+    bench_banner(label);
+    fprintf(stderr, "Cycles: %s | bytes: estimated from each stage's access pattern\n",
+            perf ? "perf_event (core)" : PROF_X86 ? "TSC (no perf_event)" : "n/a");
+    fprintf(stderr, "%-16s %-26s %3s %7s %9s %9s %5s %7s %7s %5s %7s %8s %6s\n",
+            "preset", "stage", "ch", "calls", "Msamples", "ms", "%", "ns/smp", "cyc/smp", "IPC",
+            "miss/kS", "MB", "GB/s");
+    for (int i=0; i<prof_n; ){
+        int j = i;
+        double total = 0.0;
+        while (j < prof_n && prof_entries[j].order == prof_entries[i].order) total += prof_entries[j++].st.ns;
+        for (int k=i; k<j; k++){
+            const ProfEntry *e = &prof_entries[k];
+            const ProfStat *s = &e->st;
+            double smp = s->samples ? (double)s->samples : 1.0;
+            char ch[16], ipc[16], miss[16];
+            if (e->ch < 0) snprintf(ch, sizeof(ch), "*");
+            else snprintf(ch, sizeof(ch), "%d", e->ch);
+            if (perf && s->cycles) snprintf(ipc, sizeof(ipc), "%.2f", (double)s->instr / s->cycles);
+            else snprintf(ipc, sizeof(ipc), "-");
+            if (perf) snprintf(miss, sizeof(miss), "%.2f", 1e3 * s->misses / smp);
+            else snprintf(miss, sizeof(miss), "-");
+            fprintf(stderr, "%-16.16s %-26.26s %3s %7llu %9.3f %9.3f %5.1f %7.2f %7.2f %5s %7s %8.1f %6.2f\n",
+                    k == i ? e->preset : "", e->name, ch, (unsigned long long)s->calls, s->samples / 1e6,
+                    s->ns / 1e6, total > 0.0 ? 100.0 * s->ns / total : 0.0, s->ns / smp,
+                    (double)s->cycles / smp, ipc, miss, s->bytes / 1048576.0,
+                    s->ns ? (double)s->bytes / s->ns : 0.0);
+        }
+        fprintf(stderr, "%-16s %-26s %3s %7s %9s %9.3f\n", "", "total", "", "", "", total / 1e6);
+        i = j;
+    }
+    bench_banner("end");
+    pthread_mutex_unlock(&prof_mu);
+}
+
+static void json_str(FILE *f, const char *s){
+    fputc('"', f);
+    for (; *s; s++){
+        if (*s == '"' || *s == '\\') fputc('\\', f);
+        if ((unsigned char)*s >= 0x20) fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+int prof_write_trace(const char *path){
+    FILE *f = fopen(path, "w");
+    if (!f) return 0;
+    unsigned n = atomic_load(&prof_nevents);
+    unsigned kept = prof_events ? (n < PROF_TRACE_MAX ? n : PROF_TRACE_MAX) : 0;
+    fprintf(f, "{\"displayTimeUnit\":\"ns\",\"otherData\":{\"events\":%u,\"dropped\":%u},\"traceEvents\":[\n",
+            n, n - kept);
+    unsigned threads = atomic_load(&prof_threads);
+    const char *sep = "";
+    for (unsigned t=1; t<=threads; t++){
+        fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"worker %u\"}}",
+                sep, t, t);
+        sep = ",\n";
+    }
+    for (unsigned i=0; i<kept; i++){
+        const ProfEvent *e = &prof_events[i];
+        fprintf(f, "%s{\"name\":", sep);
+        json_str(f, e->name);
+        fprintf(f, ",\"cat\":");
+        json_str(f, e->cat);
+        fprintf(f, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"ch\":%d,\"samples\":%u}}",
+                e->tid, e->ts / 1e3, e->dur / 1e3, e->ch, e->n);
+        sep = ",\n";
+    }
+    fprintf(f, "\n]}\n");
+    return fclose(f) == 0;
+}
@@ -0,0 +1,194 @@
+#include "render.h"
+#include "fixed.h"
+#include "simd.h"
+
+RenderStatus render_input_open(RenderInput *in, const char *path, const RenderOptions *opt){
+    memset(in, 0, sizeof(*in));
+    in->fd = -1;
+    in->f = fopen(path, "rb");
+    if (!in->f) return RENDER_ERR_OPEN;
+    if (!read_wav_header(in->f, &in->wi)){ render_input_close(in); return RENDER_ERR_FORMAT; }
+    in->fd = fileno(in->f);
+    in->block = opt->block;
+    in->seed = opt->seed;
+    in->tanh_mode = opt->tanh_mode;
+    in->filter_mode = opt->filter_mode;
+    in->out_format = opt->out_format < 0 ? in->wi.format : (WavFormat)opt->out_format;
+    in->streaming = opt->streaming;
+    in->fixed = opt->fixed;
+    uint64_t nframes = in->wi.data_size / ((uint64_t)in->wi.num_channels * wav_format_bytes(in->wi.format));
+    if (nframes > UINT32_MAX){ render_input_close(in); return RENDER_ERR_LENGTH; }
+    in->nframes = (uint32_t)nframes;
+    if (!in->streaming){
+        if (!wav_map_open(&in->map, in->fd, &in->wi)){ render_input_close(in); return RENDER_ERR_NOMEM; }
+        if (in->map.nframes < in->nframes){ render_input_close(in); return RENDER_ERR_SHORT; }
+        in->pcm = in->map.data;
+    }
+    return RENDER_OK;
+}
+
+void render_input_close(RenderInput *in){
+    wav_map_close(&in->map);
+    if (in->f) fclose(in->f);
+    in->f = NULL;
+    in->fd = -1;
+    in->pcm = NULL;
+}
+
+const char* render_status_text(RenderStatus s){
+    switch (s){
+        case RENDER_OK:         return "";
+        case RENDER_ERR_OPEN:   return "Kirish faylini ochishda xatolik.";
+        case RENDER_ERR_FORMAT: return "Qo'llab-quvvatlanilmaydigan WAV fayli. PCM 16/24/32-bit yoki 32-bit float bo'lishi lozim";
+        case RENDER_ERR_LENGTH: return "Fayl juda uzun: 2^32 kadrdan ortiq.";
+        case RENDER_ERR_SHORT:  return "Auduio uzunligi yetarli emas.";
+        case RENDER_ERR_NOMEM:  return "Xotira ajratishda xatolik.";
+    }
+    return "";
+}
+
+/* the signal plus a copy for head stages in memory mode, a few blocks per
+   channel when streaming, plus stage state */
+size_t render_arena_bytes(const RenderInput *in){
+    return in->streaming
+        ? (size_t)8 * in->wi.num_channels * in->block * sizeof(float) + ((size_t)4 << 20)
+        : (size_t)2 * in->wi.num_channels * in->nframes * sizeof(float) + ((size_t)4 << 20);
+}
+
+uint32_t render_latency(const PresetBook *b, int preset, uint32_t sample_rate){
+    FxChain probe;
+    uint32_t latency = 0;
+    if (preset_book_build(b, preset, &probe, (float)sample_rate, 1, NULL)){
+        latency = chain_latency(&probe);
+        chain_free(&probe);
+    }
+    return latency;
+}
+
+int render_write(const RenderInput *in, const char *path, float *const *x, const float *gain){
+    WavWriter w;
+    int ok = wav_writer_open(&w, path, in->nframes, in->wi.num_channels, in->wi.sample_rate,
+                             in->out_format, in->block)
+          && wav_writer_write_scaled(&w, x, gain, in->nframes);
+    if (!wav_writer_close(&w)) ok = 0;
+    return ok;
+}
+
+int render_channels(const RenderInput *in, const PresetBook *b, int preset, uint16_t c0, uint16_t nc,
+                    float **x, float *gain, Arena *scratch){
+    FxChain chain;
+    if (!preset_book_build(b, preset, &chain, (float)in->wi.sample_rate, nc, scratch)) return 0;
+    wav_decode_channels(x + c0, in->pcm, in->wi.format, in->wi.num_channels, c0, nc, in->nframes);
+    chain_set_seed(&chain, seed_mix(in->seed, (uint32_t)preset), c0);
+    chain_set_tanh_mode(&chain, in->tanh_mode);
+    /* a group of a wider file keeps the direct form, as its whole chain would */
+    int ok = chain_set_filter_mode(&chain, in->wi.num_channels == 1 ? in->filter_mode : FILTER_DIRECT)
+          && chain_process_buffer_gain(&chain, x + c0, in->nframes, gain + c0);
+    chain_free(&chain);
+    return ok;
+}
+
+uint16_t render_split_width(uint16_t ch, int tasks){
+    uint32_t w = tasks > 1 ? (ch + (uint32_t)tasks - 1) / (uint32_t)tasks : ch;
+    if (w > 1) w = (w + SIMD_LANES - 1) / SIMD_LANES * SIMD_LANES;
+    return (uint16_t)(w < ch ? w : ch);
+}
+
+/* in-memory mode: all channels of one preset go through a single chain,
+   so filter coefficients are designed once and cascades run the channels
+   side by side */
+static int render_memory(const RenderInput *in, const PresetBook *b, int preset, const char *path,
+                         Arena *scratch){
+    uint16_t ch = in->wi.num_channels;
+    uint32_t n = in->nframes;
+    float **x = arena_planes(scratch, ch, n);
+    float gain[ch];
+    FxChain chain;
+    int ok = 0;
+    if (x && preset_book_build(b, preset, &chain, (float)in->wi.sample_rate, ch, scratch)){
+        wav_decode(x, in->pcm, in->wi.format, ch, n);
+        chain_set_seed(&chain, seed_mix(in->seed, (uint32_t)preset), 0);
+        chain_set_tanh_mode(&chain, in->tanh_mode);
+        ok = chain_set_filter_mode(&chain, in->filter_mode) && chain_process_buffer_gain(&chain, x, n, gain);
+        chain_free(&chain);
+    }
+    return ok && render_write(in, path, x, gain);
+}
+
+static int render_stream(const RenderInput *in, const PresetBook *b, int preset, const char *path,
+                         Arena *scratch){
+    uint16_t ch = in->wi.num_channels;
+    uint32_t block = in->block;
+    WavSource src;
+    FxChain chain;
+    memset(&src, 0, sizeof(src));
+    memset(&chain, 0, sizeof(chain));
+    float **out = arena_planes(scratch, ch, block);
+    int ok = out && wav_source_open(&src, in->fd, &in->wi, block);
+    if (ok && preset_book_build(b, preset, &chain, (float)in->wi.sample_rate, ch, scratch)){
+        chain_set_seed(&chain, seed_mix(in->seed, (uint32_t)preset), 0);
+        chain_set_tanh_mode(&chain, in->tanh_mode);
+        ok = chain_set_filter_mode(&chain, in->filter_mode) && chain_prepare(&chain, &src.base, block);
+    } else ok = 0;
+
+    if (ok){
+        WavWriter w;
+        ok = wav_writer_open(&w, path, src.base.length, ch, in->wi.sample_rate,
+                             in->out_format, block);
+        uint32_t got;
+        while (ok && (got = chain_pull(&chain, out, block)) > 0)
+            ok = wav_writer_write(&w, out, got);
+        if (!wav_writer_close(&w)) ok = 0;
+    }
+    chain_free(&chain);
+    wav_source_close(&src);
+    return ok;
+}
+
+static int fixed_input(const RenderInput *in){
+    return in->fixed && !in->streaming && in->wi.format == WAV_PCM16 && in->out_format == WAV_PCM16;
+}
+
+int render_uses_fixed(const RenderInput *in, const PresetBook *b, int preset){
+    FxChain probe;
+    int ok = 0;
+    if (fixed_input(in) && preset_book_build(b, preset, &probe, (float)in->wi.sample_rate, 1, NULL)){
+        ok = fixed_chain_supported(&probe);
+        chain_free(&probe);
+    }
+    return ok;
+}
+
+/* PCM16 from the mapping to one PCM16 buffer, half the size of the float
+   planes; -1 when the preset has no fixed-point form */
+static int render_fixed(const RenderInput *in, const PresetBook *b, int preset, const char *path,
+                        Arena *scratch){
+    uint16_t ch = in->wi.num_channels;
+    FxChain chain;
+    FixedChain fc;
+    if (!preset_book_build(b, preset, &chain, (float)in->wi.sample_rate, ch, scratch)) return 0;
+    if (!fixed_chain_supported(&chain)){ chain_free(&chain); return -1; }
+    int ok = fixed_chain_init(&fc, &chain, scratch);
+    chain_free(&chain);
+    uint8_t *out = ok ? (uint8_t*)arena_alloc(scratch, (size_t)in->nframes * ch * 2) : NULL;
+    ok = out && fixed_chain_process(&fc, in->pcm, out, in->nframes);
+    if (ok){
+        WavWriter w;
+        ok = wav_writer_open(&w, path, in->nframes, ch, in->wi.sample_rate, WAV_PCM16, in->block)
+          && wav_writer_write_raw(&w, out, in->nframes);
+        if (!wav_writer_close(&w)) ok = 0;
+    }
+    arena_free(scratch, out);
+    fixed_chain_free(&fc);
+    return ok;
+}
+
+int render_preset(const RenderInput *in, const PresetBook *b, int preset, const char *path,
+                  Arena *scratch){
+    if (fixed_input(in)){
+        int r = render_fixed(in, b, preset, path, scratch);
+        if (r >= 0) return r;
+    }
+    return in->streaming ? render_stream(in, b, preset, path, scratch)
+                         : render_memory(in, b, preset, path, scratch);
+}
@@ -0,0 +1,238 @@
+#include "resample.h"
+#include "simd.h"
+
+#include <pthread.h>
+
+void resample_ratio_rational(double ratio, uint32_t *L, uint32_t *M){
+    uint32_t bl = 1, bm = 1;
+    double best = 1e300;
+    for (uint32_t m=1; m<=RS_MAX_PHASES; m++){
+        double l = floor(ratio*(double)m + 0.5);
+        if (l < 1.0 || l > (double)RS_MAX_PHASES) continue;
+        double err = fabs(l/(double)m - ratio);
+        if (err < best){ best = err; bl = (uint32_t)l; bm = m; }
+        if (err == 0.0) break;
+    }
+    *L = bl; *M = bm;
+}
+
+static double bessel_i0(double x){
+    double sum = 1.0, term = 1.0, q = 0.25*x*x;
+    for (int k=1;k<64;k++){
+        term *= q / ((double)k*(double)k);
+        sum += term;
+        if (term < sum*1e-17) break;
+    }
+    return sum;
+}
+
+static ResampleBank* bank_build(uint32_t L, uint32_t M, ResampleQuality q){
+    static const int    base_taps[] = { 8, 16, 32 };
+    static const double beta_tab[]  = { 6.0, 8.0, 10.0 };
+    static const double rolloff[]   = { 0.85, 0.90, 0.94 };
+    double scale = (L < M) ? (double)L/(double)M : 1.0;
+    double fc = 0.5 * scale * rolloff[q];
+    int taps = (int)ceil((double)base_taps[q] / scale);
+    taps = (taps + 3) & ~3;
+    int h = taps/2;
+
+    ResampleBank *b = (ResampleBank*)malloc(sizeof(*b));
+    if (!b) return NULL;
+    b->h = (float*)malloc(sizeof(float)*(size_t)L*(size_t)taps);
+    if (!b->h){ free(b); return NULL; }
+    b->L = L; b->M = M; b->taps = taps;
+
+    double i0b = bessel_i0(beta_tab[q]);
+    double *row = (double*)malloc(sizeof(double)*(size_t)taps);
+    if (!row){ free(b->h); free(b); return NULL; }
+    for (uint32_t p=0; p<L; p++){
+        double sum = 0.0;
+        for (int j=0;j<taps;j++){
+            double t = (double)(j - h + 1) - (double)p/(double)L;
+            double r = t/(double)h, w = 0.0;
+            if (fabs(r) < 1.0) w = bessel_i0(beta_tab[q]*sqrt(1.0 - r*r)) / i0b;
+            double a = 2.0*fc*t;
+            double sinc = (fabs(a) < 1e-12) ? 1.0 : sin(M_PI*a)/(M_PI*a);
+            row[j] = 2.0*fc*sinc*w;
+            sum += row[j];
+        }
+        for (int j=0;j<taps;j++) b->h[(size_t)p*taps + j] = (float)(row[j]/sum);
+    }
+    free(row);
+    return b;
+}
+
+typedef struct BankEntry {
+    ResampleBank      *bank;
+    ResampleQuality    q;
+    struct BankEntry  *next;
+} BankEntry;
+
+static pthread_mutex_t bank_mu = PTHREAD_MUTEX_INITIALIZER;
+static BankEntry      *bank_list = NULL;
+
+const ResampleBank* resample_bank_get(uint32_t L, uint32_t M, ResampleQuality q){
+    if (!L || !M || L > RS_MAX_PHASES || M > RS_MAX_PHASES) return NULL;
+    pthread_mutex_lock(&bank_mu);
+    BankEntry *e = bank_list;
+    while (e && !(e->bank->L == L && e->bank->M == M && e->q == q)) e = e->next;
+    if (!e){
+        ResampleBank *b = bank_build(L, M, q);
+        e = b ? (BankEntry*)malloc(sizeof(*e)) : NULL;
+        if (e){ e->bank = b; e->q = q; e->next = bank_list; bank_list = e; }
+        else if (b){ free(b->h); free(b); }
+    }
+    pthread_mutex_unlock(&bank_mu);
+    return e ? e->bank : NULL;
+}
+
+void resample_cache_clear(void){
+    pthread_mutex_lock(&bank_mu);
+    while (bank_list){
+        BankEntry *e = bank_list;
+        bank_list = e->next;
+        free(e->bank->h); free(e->bank); free(e);
+    }
+    pthread_mutex_unlock(&bank_mu);
+}
+
+int resampler_init(Resampler *r, const ResampleBank *bank, uint16_t nch, uint32_t chunk,
+                   Arena *mem){
+    memset(r,0,sizeof(*r));
+    r->mem = mem;
+    if (!bank || !nch) return 0;
+    r->bank = bank;
+    r->nch = nch;
+    r->cap = (uint32_t)bank->taps + chunk;
+    r->step_i = bank->M / bank->L;
+    r->step_f = bank->M % bank->L;
+    r->buf = arena_planes(mem, nch, r->cap);
+    if (!r->buf) return 0;
+    resampler_reset(r);
+    return 1;
+}
+
+void resampler_reset(Resampler *r){
+    int h = r->bank->taps/2;
+    r->base = 1 - h;
+    r->fill = (uint32_t)(h - 1);
+    for (uint16_t c=0;c<r->nch;c++) memset(r->buf[c], 0, sizeof(float)*r->fill);
+    r->idx = 0;
+    r->phase = 0;
+}
+
+void resampler_free(Resampler *r){
+    arena_free_planes(r->mem, r->buf, r->nch);
+    r->buf = NULL;
+}
+
+static inline float fir_dot(const float *h, const float *x, int taps){
+#if SIMD_VEC
+    v4sf acc = {0};
+    for (int j=0;j<taps;j+=4){
+        v4sf a, b;
+        memcpy(&a, h+j, 16); memcpy(&b, x+j, 16);
+        acc += a*b;
+    }
+    return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+#else
+    float acc = 0.0f;
+    for (int j=0;j<taps;j++) acc += h[j]*x[j];
+    return acc;
+#endif
+}
+
+uint32_t resampler_process(Resampler *r, float *const *in, uint32_t n_in, uint32_t *consumed,
+                           float **out, uint32_t out_cap){
+    const ResampleBank *b = r->bank;
+    int taps = b->taps, h = taps/2;
+    uint32_t produced = 0, used = 0;
+    for (;;){
+        while (produced < out_cap){
+            int64_t lo = r->idx - h + 1;
+            if (r->idx + h >= r->base + (int64_t)r->fill) break;
+            const float *hp = b->h + (size_t)r->phase*taps;
+            uint32_t off = (uint32_t)(lo - r->base);
+            for (uint16_t c=0;c<r->nch;c++) out[c][produced] = fir_dot(hp, r->buf[c] + off, taps);
+            produced++;
+            r->idx += r->step_i;
+            r->phase += r->step_f;
+            if (r->phase >= b->L){ r->phase -= b->L; r->idx++; }
+        }
+        if (produced == out_cap || used == n_in) break;
+
+        int64_t lo = r->idx - h + 1;
+        if (lo > r->base){
+            uint32_t drop = (lo - r->base > (int64_t)r->fill) ? r->fill : (uint32_t)(lo - r->base);
+            for (uint16_t c=0;c<r->nch;c++)
+                memmove(r->buf[c], r->buf[c] + drop, sizeof(float)*(r->fill - drop));
+            r->fill -= drop; r->base += drop;
+        }
+        uint32_t k = r->cap - r->fill;
+        if (k > n_in - used) k = n_in - used;
+        if (!k) break;
+        for (uint16_t c=0;c<r->nch;c++){
+            if (in) memcpy(r->buf[c] + r->fill, in[c] + used, sizeof(float)*k);
+            else memset(r->buf[c] + r->fill, 0, sizeof(float)*k);
+        }
+        r->fill += k; used += k;
+    }
+    if (consumed) *consumed = used;
+    return produced;
+}
+
+static uint32_t pr_read(FxSource *s, float **dst, uint32_t count){
+    PolyResampler *p = (PolyResampler*)s;
+    uint16_t nch = s->nch;
+    if (count > s->length - p->pos) count = s->length - p->pos;
+    uint32_t done = 0;
+    while (done < count){
+        if (p->used == p->pend){
+            uint32_t got = p->up->read(p->up, p->tmp, p->chunk);
+            if (!got){
+                for (uint16_t c=0;c<nch;c++) memset(p->tmp[c], 0, sizeof(float)*p->chunk);
+                got = p->chunk;
+            }
+            p->pend = got; p->used = 0;
+        }
+        float *in[nch], *o[nch];
+        for (uint16_t c=0;c<nch;c++){ in[c] = p->tmp[c] + p->used; o[c] = dst[c] + done; }
+        uint32_t used = 0;
+        done += resampler_process(&p->rs, in, p->pend - p->used, &used, o, count - done);
+        p->used += used;
+    }
+    p->pos += done;
+    return done;
+}
+
+static void pr_rewind(FxSource *s){
+    PolyResampler *p = (PolyResampler*)s;
+    p->up->rewind(p->up);
+    resampler_reset(&p->rs);
+    p->pend = p->used = p->pos = 0;
+}
+
+int poly_resampler_init(PolyResampler *p, FxSource *up, float ratio, ResampleQuality q,
+                        uint32_t block, Arena *mem){
+    memset(p,0,sizeof(*p));
+    if (ratio <= 0.0001f) ratio = 0.0001f;
+    uint32_t L, M;
+    resample_ratio_rational((double)ratio, &L, &M);
+    p->base.read = pr_read;
+    p->base.rewind = pr_rewind;
+    p->base.length = (uint32_t)((uint64_t)up->length * L / M);
+    if (!p->base.length) p->base.length = 1;
+    p->base.nch = up->nch;
+    p->up = up;
+    p->chunk = block;
+    if (!resampler_init(&p->rs, resample_bank_get(L, M, q), up->nch, block, mem)) return 0;
+    p->tmp = arena_planes(mem, up->nch, block);
+    if (!p->tmp){ poly_resampler_free(p); return 0; }
+    return 1;
+}
+
+void poly_resampler_free(PolyResampler *p){
+    resampler_free(&p->rs);
+    arena_free_planes(p->rs.mem, p->tmp, p->base.nch);
+    p->tmp = NULL;
+}
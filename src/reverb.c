@@ -0,0 +1,128 @@
+#include "reverb.h"
+#include "dsp.h"
+
+int delay_init(DelayLine *d, uint32_t max_delay, Arena *mem){
+    d->mem = mem;
+    d->buf = NULL;
+    if (max_delay >= (1u << 31)) return 0;
+    uint32_t size = 1;
+    while (size <= max_delay) size <<= 1;
+    d->mem = mem;
+    d->buf = (float*)arena_calloc(mem, size, sizeof(float));
+    d->mask = size - 1;
+    d->pos = 0;
+    return d->buf != NULL;
+}
+void delay_reset(DelayLine *d){
+    if (d->buf) memset(d->buf, 0, sizeof(float)*(d->mask + 1));
+    d->pos = 0;
+}
+void delay_free(DelayLine *d){
+    arena_free(d->mem, d->buf); d->buf = NULL;
+}
+
+int tapdelay_init(TapDelay *t, const uint32_t *d, const float *g, int ntaps, Arena *mem){
+    memset(t,0,sizeof(*t));
+    if (ntaps < 1 || ntaps > TAPDELAY_MAX_TAPS) return 0;
+    /* longest delay first: matches the summation order of the scatter-add form */
+    for (int k=0;k<ntaps;k++){
+        int j=k;
+        while (j>0 && t->d[j-1] < d[k]){ t->d[j]=t->d[j-1]; t->g[j]=t->g[j-1]; j--; }
+        t->d[j]=d[k]; t->g[j]=g[k];
+    }
+    t->ntaps = ntaps;
+    return delay_init(&t->dl, t->d[0], mem);
+}
+void tapdelay_reset(TapDelay *t){ delay_reset(&t->dl); }
+void tapdelay_process(TapDelay *t, float *x, uint32_t n){
+    for (uint32_t i=0;i<n;i++){
+        float in = x[i], acc = in;
+        for (int k=0;k<t->ntaps;k++) acc += t->g[k] * delay_read(&t->dl, t->d[k]);
+        delay_write(&t->dl, in);
+        x[i] = acc;
+    }
+}
+void tapdelay_free(TapDelay *t){ delay_free(&t->dl); }
+
+int fdn_init(Fdn *f, float sr, const float *delay_sec, float rt60, float damping, Arena *mem){
+    memset(f,0,sizeof(*f));
+    if (rt60 < 0.01f) rt60 = 0.01f;
+    f->damp = fminf(fmaxf(damping, 0.0f), 0.99f);
+    for (int k=0;k<FDN_LINES;k++){
+        float t = delay_sec[k]*sr;
+        if (!(t >= 0.0f && t < 2147483648.0f)){ fdn_free(f); return 0; }
+        uint32_t len = (uint32_t)t;
+        if (len < 1) len = 1;
+        f->len[k] = len;
+        /* -60 dB after rt60 seconds: g^(rt60*sr/len) = 10^-3 */
+        f->g[k] = powf(10.0f, -3.0f * (float)len / (rt60 * sr));
+        if (!delay_init(&f->line[k], len, mem)){ fdn_free(f); return 0; }
+    }
+    return 1;
+}
+void fdn_reset(Fdn *f){
+    for (int k=0;k<FDN_LINES;k++){ delay_reset(&f->line[k]); f->lp[k] = 0.0f; }
+}
+void fdn_free(Fdn *f){
+    for (int k=0;k<FDN_LINES;k++) delay_free(&f->line[k]);
+}
+
+/* one network step: returns the tail output for input `in` */
+static inline float fdn_tick(Fdn *f, float in){
+    float s[FDN_LINES], out = 0.0f, d = f->damp;
+    for (int k=0;k<FDN_LINES;k++){
+        float o = delay_read(&f->line[k], f->len[k]);
+        out += o;
+        f->lp[k] = flush_denormal(o + d*(f->lp[k] - o));
+        s[k] = f->g[k] * f->lp[k];
+    }
+    float a = s[0] + s[1], b = s[0] - s[1], c = s[2] + s[3], e = s[2] - s[3];
+    delay_write(&f->line[0], in + 0.5f*(a + c));
+    delay_write(&f->line[1], in + 0.5f*(b + e));
+    delay_write(&f->line[2], in + 0.5f*(a - c));
+    delay_write(&f->line[3], in + 0.5f*(b - e));
+    return out * (1.0f/FDN_LINES);
+}
+
+int reverb_init(Reverb *r, float sr, const ReverbParams *p, Arena *mem){
+    memset(r,0,sizeof(*r));
+    if (p->ntaps > 0){
+        uint32_t d[TAPDELAY_MAX_TAPS];
+        for (int k=0;k<p->ntaps;k++){
+            float t = p->tap_sec[k]*sr;
+            if (!(t >= 0.0f && t < 2147483648.0f)) return 0;
+            d[k] = (uint32_t)t;
+        }
+        if (!tapdelay_init(&r->early, d, p->tap_gain, p->ntaps, mem)) return 0;
+        r->has_early = 1;
+    }
+    if (p->fdn_sec[0] > 0.0f && p->wet > 0.0f){
+        if (!fdn_init(&r->fdn, sr, p->fdn_sec, p->rt60, p->damping, mem)){ reverb_free(r); return 0; }
+        r->has_fdn = 1;
+        r->wet = p->wet;
+    }
+    return 1;
+}
+void reverb_reset(Reverb *r){
+    if (r->has_early) tapdelay_reset(&r->early);
+    if (r->has_fdn) fdn_reset(&r->fdn);
+}
+void reverb_process(Reverb *r, float *x, uint32_t n){
+    if (!r->has_fdn){
+        if (r->has_early) tapdelay_process(&r->early, x, n);
+        return;
+    }
+    float tail[256];
+    for (uint32_t off=0; off<n; off+=256){
+        uint32_t cnt = (n - off < 256) ? n - off : 256;
+        float *blk = x + off;
+        for (uint32_t i=0;i<cnt;i++) tail[i] = fdn_tick(&r->fdn, blk[i]);
+        if (r->has_early) tapdelay_process(&r->early, blk, cnt);
+        for (uint32_t i=0;i<cnt;i++) blk[i] += r->wet * tail[i];
+    }
+}
+void reverb_free(Reverb *r){
+    if (r->has_early) tapdelay_free(&r->early);
+    if (r->has_fdn) fdn_free(&r->fdn);
+    r->has_early = r->has_fdn = 0;
+}
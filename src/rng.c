@@ -0,0 +1,128 @@
+#include "rng.h"
+#include "simd.h"
+
+#include <pthread.h>
+
+static uint64_t splitmix64(uint64_t *x){
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+void rng_seed(Rng *r, uint64_t seed){
+    for (int l=0;l<4;l++){
+        for (int w=0;w<4;w+=2){
+            uint64_t v = splitmix64(&seed);
+            r->s[w][l] = (uint32_t)v;
+            r->s[w+1][l] = (uint32_t)(v >> 32);
+        }
+        if (!(r->s[0][l] | r->s[1][l] | r->s[2][l] | r->s[3][l])) r->s[0][l] = 1;
+    }
+    r->pos = RNG_BUF;
+}
+
+static void rng_refill(Rng *r){
+#if SIMD_VEC
+    v4su s0, s1, s2, s3;
+    memcpy(&s0, r->s[0], 16); memcpy(&s1, r->s[1], 16);
+    memcpy(&s2, r->s[2], 16); memcpy(&s3, r->s[3], 16);
+    for (int i=0;i<RNG_BUF;i+=4){
+        v4su t = s0 + s3;
+        v4su out = ((t << 7) | (t >> 25)) + s0;
+        memcpy(r->buf + i, &out, 16);
+        t = s1 << 9;
+        s2 ^= s0; s3 ^= s1; s1 ^= s2; s0 ^= s3;
+        s2 ^= t;
+        s3 = (s3 << 11) | (s3 >> 21);
+    }
+    memcpy(r->s[0], &s0, 16); memcpy(r->s[1], &s1, 16);
+    memcpy(r->s[2], &s2, 16); memcpy(r->s[3], &s3, 16);
+#else
+    for (int i=0;i<RNG_BUF;i+=4){
+        for (int l=0;l<4;l++){
+            uint32_t *s0=&r->s[0][l], *s1=&r->s[1][l], *s2=&r->s[2][l], *s3=&r->s[3][l];
+            uint32_t t = *s0 + *s3;
+            r->buf[i+l] = ((t << 7) | (t >> 25)) + *s0;
+            t = *s1 << 9;
+            *s2 ^= *s0; *s3 ^= *s1; *s1 ^= *s2; *s0 ^= *s3;
+            *s2 ^= t;
+            *s3 = (*s3 << 11) | (*s3 >> 21);
+        }
+    }
+#endif
+    r->pos = 0;
+}
+
+uint32_t rng_u32(Rng *r){
+    if (r->pos == RNG_BUF) rng_refill(r);
+    return r->buf[r->pos++];
+}
+
+float rng_uniform(Rng *r){
+    return ((float)(rng_u32(r) >> 8) + 1.0f) * (1.0f/16777216.0f);
+}
+
+/* Marsaglia & Tsang (2000) 128-layer Ziggurat tables */
+static uint32_t zig_k[128];
+static float    zig_w[128], zig_f[128];
+static pthread_once_t zig_once = PTHREAD_ONCE_INIT;
+
+static void zig_init(void){
+    const double m1 = 2147483648.0, vn = 9.91256303526217e-3;
+    double dn = 3.442619855899, tn = dn;
+    double q = vn/exp(-0.5*dn*dn);
+    zig_k[0] = (uint32_t)((dn/q)*m1);
+    zig_k[1] = 0;
+    zig_w[0] = (float)(q/m1);
+    zig_w[127] = (float)(dn/m1);
+    zig_f[0] = 1.0f;
+    zig_f[127] = (float)exp(-0.5*dn*dn);
+    for (int i=126;i>=1;i--){
+        dn = sqrt(-2.0*log(vn/dn + exp(-0.5*dn*dn)));
+        zig_k[i+1] = (uint32_t)((dn/tn)*m1);
+        tn = dn;
+        zig_f[i] = (float)exp(-0.5*dn*dn);
+        zig_w[i] = (float)(dn/m1);
+    }
+}
+
+static inline uint32_t uabs32(int32_t v){
+    return v < 0 ? 0u - (uint32_t)v : (uint32_t)v;
+}
+
+static float zig_tail(Rng *r, int32_t hz, uint32_t iz){
+    const float R = 3.442620f;
+    for (;;){
+        float x = (float)hz * zig_w[iz];
+        if (iz == 0){
+            float y;
+            do {
+                x = -logf(rng_uniform(r)) * 0.2904764f;
+                y = -logf(rng_uniform(r));
+            } while (y + y < x*x);
+            return (hz > 0) ? R + x : -R - x;
+        }
+        if (zig_f[iz] + rng_uniform(r)*(zig_f[iz-1] - zig_f[iz]) < expf(-0.5f*x*x)) return x;
+        hz = (int32_t)rng_u32(r);
+        iz = (uint32_t)hz & 127;
+        if (uabs32(hz) < zig_k[iz]) return (float)hz * zig_w[iz];
+    }
+}
+
+static inline float zig_normal(Rng *r){
+    int32_t hz = (int32_t)rng_u32(r);
+    uint32_t iz = (uint32_t)hz & 127;
+    if (uabs32(hz) < zig_k[iz]) return (float)hz * zig_w[iz];
+    return zig_tail(r, hz, iz);
+}
+
+float rng_normal(Rng *r){
+    pthread_once(&zig_once, zig_init);
+    return zig_normal(r);
+}
+
+void rng_normal_block(Rng *r, float *out, uint32_t n){
+    pthread_once(&zig_once, zig_init);
+    for (uint32_t i=0;i<n;i++) out[i] = zig_normal(r);
+}
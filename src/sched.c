@@ -0,0 +1,172 @@
+#include "sched.h"
+#include "fpmode.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+typedef struct {
+    SchedFn fn;
+    void   *arg;
+} SchedTask;
+
+/* ring buffer; head is the front (stolen from), head+len the back */
+typedef struct {
+    pthread_mutex_t mu;
+    SchedTask      *v;
+    size_t          head, len, cap;
+} Deque;
+
+typedef struct {
+    Sched    *s;
+    int       id;
+    pthread_t th;
+} Worker;
+
+struct Sched {
+    int              nworkers;
+    Deque           *dq;
+    Arena           *arenas;
+    Worker          *workers;
+    pthread_mutex_t  mu;
+    pthread_cond_t   wake;
+    atomic_int       queued;        /* sitting in a deque */
+    atomic_int       outstanding;   /* queued or running */
+    atomic_ullong    steals;
+    int              next;
+};
+
+static int deque_push(Deque *d, SchedFn fn, void *arg){
+    pthread_mutex_lock(&d->mu);
+    if (d->len == d->cap){
+        size_t cap = d->cap ? d->cap * 2 : 64;
+        SchedTask *v = (SchedTask*)malloc(cap * sizeof(*v));
+        if (!v){ pthread_mutex_unlock(&d->mu); return 0; }
+        for (size_t i=0; i<d->len; i++) v[i] = d->v[(d->head + i) % d->cap];
+        free(d->v);
+        d->v = v;
+        d->cap = cap;
+        d->head = 0;
+    }
+    d->v[(d->head + d->len) % d->cap] = (SchedTask){ fn, arg };
+    d->len++;
+    pthread_mutex_unlock(&d->mu);
+    return 1;
+}
+
+static int deque_take(Deque *d, int front, SchedTask *t){
+    pthread_mutex_lock(&d->mu);
+    int ok = d->len > 0;
+    if (ok){
+        if (front){
+            *t = d->v[d->head];
+            d->head = (d->head + 1) % d->cap;
+        } else {
+            *t = d->v[(d->head + d->len - 1) % d->cap];
+        }
+        d->len--;
+    }
+    pthread_mutex_unlock(&d->mu);
+    return ok;
+}
+
+static int sched_find(Sched *s, int id, SchedTask *t){
+    if (deque_take(&s->dq[id], 0, t)) return 1;
+    for (int k=1; k<s->nworkers; k++){
+        if (deque_take(&s->dq[(id + k) % s->nworkers], 1, t)){
+            atomic_fetch_add(&s->steals, 1);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void* sched_worker(void *arg){
+    Worker *w = (Worker*)arg;
+    Sched *s = w->s;
+    SchedTask t;
+    fpmode_apply();
+    for (;;){
+        if (atomic_load(&s->queued) > 0 && sched_find(s, w->id, &t)){
+            atomic_fetch_sub(&s->queued, 1);
+            arena_reset(&s->arenas[w->id]);
+            t.fn(t.arg, &s->arenas[w->id], s, w->id);
+            if (atomic_fetch_sub(&s->outstanding, 1) == 1){
+                pthread_mutex_lock(&s->mu);
+                pthread_cond_broadcast(&s->wake);
+                pthread_mutex_unlock(&s->mu);
+            }
+            continue;
+        }
+        pthread_mutex_lock(&s->mu);
+        while (atomic_load(&s->queued) == 0 && atomic_load(&s->outstanding) > 0)
+            pthread_cond_wait(&s->wake, &s->mu);
+        int done = atomic_load(&s->outstanding) == 0;
+        pthread_mutex_unlock(&s->mu);
+        if (done) break;
+    }
+    return NULL;
+}
+
+Sched* sched_create(int nworkers, size_t arena_bytes){
+    if (nworkers < 1) nworkers = 1;
+    Sched *s = (Sched*)calloc(1, sizeof(*s));
+    if (!s) return NULL;
+    pthread_mutex_init(&s->mu, NULL);
+    pthread_cond_init(&s->wake, NULL);
+    s->dq = (Deque*)calloc((size_t)nworkers, sizeof(Deque));
+    s->arenas = (Arena*)calloc((size_t)nworkers, sizeof(Arena));
+    s->workers = (Worker*)calloc((size_t)nworkers, sizeof(Worker));
+    if (!s->dq || !s->arenas || !s->workers){ sched_destroy(s); return NULL; }
+    for (int i=0; i<nworkers; i++){
+        pthread_mutex_init(&s->dq[i].mu, NULL);
+        s->nworkers++;
+        if (!arena_init(&s->arenas[i], arena_bytes)){ sched_destroy(s); return NULL; }
+    }
+    return s;
+}
+
+int sched_push(Sched *s, int worker, SchedFn fn, void *arg){
+    if (worker < 0) worker = s->next++ % s->nworkers;
+    atomic_fetch_add(&s->outstanding, 1);
+    if (!deque_push(&s->dq[worker], fn, arg)){
+        atomic_fetch_sub(&s->outstanding, 1);
+        return 0;
+    }
+    atomic_fetch_add(&s->queued, 1);
+    pthread_mutex_lock(&s->mu);
+    pthread_cond_signal(&s->wake);
+    pthread_mutex_unlock(&s->mu);
+    return 1;
+}
+
+int sched_run(Sched *s){
+    int started = 0;
+    for (int i=0; i<s->nworkers; i++){
+        s->workers[i].s = s;
+        s->workers[i].id = i;
+        if (pthread_create(&s->workers[i].th, NULL, sched_worker, &s->workers[i]) != 0) break;
+        started++;
+    }
+    /* a worker that failed to start leaves its deque to be stolen from */
+    for (int i=0; i<started; i++) pthread_join(s->workers[i].th, NULL);
+    return started > 0;
+}
+
+uint64_t sched_steals(Sched *s){
+    return atomic_load(&s->steals);
+}
+
+void sched_destroy(Sched *s){
+    if (!s) return;
+    for (int i=0; i<s->nworkers; i++){
+        free(s->dq[i].v);
+        pthread_mutex_destroy(&s->dq[i].mu);
+        arena_destroy(&s->arenas[i]);
+    }
+    free(s->dq);
+    free(s->arenas);
+    free(s->workers);
+    pthread_mutex_destroy(&s->mu);
+    pthread_cond_destroy(&s->wake);
+    free(s);
+}
@@ -0,0 +1,294 @@
+#include "server.h"
+#include "pool.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define SERVE_LAT_WINDOW 1024    /* latencies kept for the percentiles */
+#define SERVE_PATH_MAX   4096
+
+typedef struct Server Server;
+
+typedef struct Conn {
+    Server      *srv;
+    int          fd;
+    struct Conn *next;
+} Conn;
+
+struct Server {
+    const PresetBook *book;
+    RenderOptions     opt;
+    ThreadPool       *pool;
+    pthread_mutex_t   mu;
+    pthread_cond_t    closed;
+    Conn             *conns;
+    int               nconns;
+    int               active;
+    uint64_t          done, failed;
+    double            lat[SERVE_LAT_WINDOW];   /* ms, ring */
+    uint64_t          nlat;
+};
+
+/* one render request: every preset of it is a pool task */
+typedef struct {
+    Server          *srv;
+    RenderInput      in;
+    pthread_mutex_t  mu;
+    pthread_cond_t   finished;
+    int              remaining, failed;
+} ServeJob;
+
+typedef struct {
+    ServeJob *job;
+    int       preset;
+    char      path[SERVE_PATH_MAX];
+} ServeTask;
+
+static volatile sig_atomic_t serve_stop;
+
+static void on_signal(int sig){ (void)sig; serve_stop = 1; }
+
+static double now_ms(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void serve_task(void *arg, Arena *scratch){
+    ServeTask *t = (ServeTask*)arg;
+    ServeJob *j = t->job;
+    int ok = render_preset(&j->in, j->srv->book, t->preset, t->path, scratch);
+    pthread_mutex_lock(&j->mu);
+    if (!ok) j->failed++;
+    if (--j->remaining == 0) pthread_cond_signal(&j->finished);
+    pthread_mutex_unlock(&j->mu);
+}
+
+static int ends_with_wav(const char *s){
+    size_t n = strlen(s);
+    return n > 4 && strcmp(s + n - 4, ".wav") == 0;
+}
+
+static void serve_render(Conn *c, char *inpath, char *out, char *list){
+    Server *s = c->srv;
+    double t0 = now_ms();
+    int sel[s->book->n];
+    const char *bad = NULL;
+    int n = preset_book_select(s->book, list, sel, &bad);
+    if (n < 0){ dprintf(c->fd, "err Noma'lum preset: %s\n", bad); return; }
+    if (n == 0){ dprintf(c->fd, "err Preset tanlanmadi\n"); return; }
+    int single = n == 1 && ends_with_wav(out);
+    if (!single && MKDIR_P(out) != 0 && errno != EEXIST){
+        dprintf(c->fd, "err Katalog yaratib bo'lmadi: %s\n", out);
+        return;
+    }
+
+    ServeJob job;
+    RenderStatus st = render_input_open(&job.in, inpath, &s->opt);
+    if (st != RENDER_OK){ dprintf(c->fd, "err %s\n", render_status_text(st)); return; }
+    ServeTask *tasks = (ServeTask*)calloc((size_t)n, sizeof(ServeTask));
+    if (!tasks){
+        render_input_close(&job.in);
+        dprintf(c->fd, "err %s\n", render_status_text(RENDER_ERR_NOMEM));
+        return;
+    }
+    job.srv = s;
+    job.remaining = n;
+    job.failed = 0;
+    pthread_mutex_init(&job.mu, NULL);
+    pthread_cond_init(&job.finished, NULL);
+
+    pthread_mutex_lock(&s->mu);
+    s->active++;
+    pthread_mutex_unlock(&s->mu);
+
+    for (int i=0; i<n; i++){
+        ServeTask *t = &tasks[i];
+        t->job = &job;
+        t->preset = sel[i];
+        if (single) snprintf(t->path, sizeof(t->path), "%s", out);
+        else snprintf(t->path, sizeof(t->path), "%s/%s.wav", out, s->book->v[sel[i]].name);
+        if (!pool_submit(s->pool, serve_task, t)){
+            pthread_mutex_lock(&job.mu);
+            job.failed++;
+            job.remaining--;
+            pthread_mutex_unlock(&job.mu);
+        }
+    }
+    pthread_mutex_lock(&job.mu);
+    while (job.remaining) pthread_cond_wait(&job.finished, &job.mu);
+    pthread_mutex_unlock(&job.mu);
+
+    double ms = now_ms() - t0;
+    pthread_mutex_lock(&s->mu);
+    s->active--;
+    if (job.failed) s->failed++; else s->done++;
+    s->lat[s->nlat++ % SERVE_LAT_WINDOW] = ms;
+    pthread_mutex_unlock(&s->mu);
+
+    if (job.failed) dprintf(c->fd, "err %d ta chiqishni saqlashda xatolik\n", job.failed);
+    else dprintf(c->fd, "ok %d %.3f\n", n, ms);
+
+    pthread_mutex_destroy(&job.mu);
+    pthread_cond_destroy(&job.finished);
+    free(tasks);
+    render_input_close(&job.in);
+}
+
+static int cmp_double(const void *a, const void *b){
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static void serve_stats(Conn *c){
+    Server *s = c->srv;
+    double lat[SERVE_LAT_WINDOW];
+    pthread_mutex_lock(&s->mu);
+    int n = s->nlat < SERVE_LAT_WINDOW ? (int)s->nlat : SERVE_LAT_WINDOW;
+    memcpy(lat, s->lat, (size_t)n * sizeof(double));
+    uint64_t done = s->done, failed = s->failed;
+    int active = s->active;
+    pthread_mutex_unlock(&s->mu);
+    int queued = pool_queued(s->pool);
+
+    qsort(lat, (size_t)n, sizeof(double), cmp_double);
+    #define PCT(p) (n ? lat[(int)((n - 1) * (p) + 0.5)] : 0.0)
+    dprintf(c->fd, "stats done=%llu failed=%llu active=%d queued=%d"
+                   " p50_ms=%.3f p95_ms=%.3f p99_ms=%.3f max_ms=%.3f\n",
+            (unsigned long long)done, (unsigned long long)failed, active, queued,
+            PCT(0.50), PCT(0.95), PCT(0.99), PCT(1.0));
+    #undef PCT
+}
+
+static void* serve_conn(void *arg){
+    Conn *c = (Conn*)arg;
+    Server *s = c->srv;
+    FILE *r = fdopen(c->fd, "r");
+    char *line = NULL;
+    size_t cap = 0;
+    while (r && getline(&line, &cap, r) > 0){
+        char *save = NULL;
+        char *cmd = strtok_r(line, " \t\r\n", &save);
+        if (!cmd) continue;
+        if (strcmp(cmd, "render") == 0){
+            char *in = strtok_r(NULL, " \t\r\n", &save);
+            char *out = strtok_r(NULL, " \t\r\n", &save);
+            char *list = strtok_r(NULL, " \t\r\n", &save);
+            if (!in || !out) dprintf(c->fd, "err Foydalanish: render in.wav chiqish [preset,...]\n");
+            else serve_render(c, in, out, list);
+        } else if (strcmp(cmd, "stats") == 0){
+            serve_stats(c);
+        } else if (strcmp(cmd, "quit") == 0){
+            break;
+        } else if (strcmp(cmd, "shutdown") == 0){
+            serve_stop = 1;
+            dprintf(c->fd, "ok\n");
+        } else {
+            dprintf(c->fd, "err Noma'lum buyruq: %s\n", cmd);
+        }
+    }
+    free(line);
+
+    pthread_mutex_lock(&s->mu);
+    for (Conn **p = &s->conns; *p; p = &(*p)->next)
+        if (*p == c){ *p = c->next; break; }
+    if (--s->nconns == 0) pthread_cond_broadcast(&s->closed);
+    pthread_mutex_unlock(&s->mu);
+    if (r) fclose(r); else close(c->fd);
+    free(c);
+    return NULL;
+}
+
+static void serve_accept(Server *s, int lfd){
+    int fd = accept(lfd, NULL, NULL);
+    if (fd < 0) return;
+    Conn *c = (Conn*)calloc(1, sizeof(*c));
+    if (!c){ close(fd); return; }
+    c->srv = s;
+    c->fd = fd;
+    pthread_mutex_lock(&s->mu);
+    c->next = s->conns;
+    s->conns = c;
+    s->nconns++;
+    pthread_mutex_unlock(&s->mu);
+
+    pthread_attr_t attr;
+    pthread_t th;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&th, &attr, serve_conn, c) != 0){
+        pthread_mutex_lock(&s->mu);
+        s->conns = c->next;
+        s->nconns--;
+        pthread_mutex_unlock(&s->mu);
+        close(fd);
+        free(c);
+    }
+    pthread_attr_destroy(&attr);
+}
+
+int serve(const char *sock_path, const PresetBook *book, const RenderOptions *opt, int threads){
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(sock_path) >= sizeof(addr.sun_path)) return 0;
+    strcpy(addr.sun_path, sock_path);
+
+    /* a socket left behind by a previous run is replaced, anything else is not */
+    struct stat st;
+    if (stat(sock_path, &st) == 0 && S_ISSOCK(st.st_mode)) unlink(sock_path);
+
+    int lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (lfd < 0) return 0;
+    if (bind(lfd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(lfd, 128) != 0){
+        close(lfd);
+        return 0;
+    }
+
+    /* arenas grow to the largest job they see and keep those pages */
+    Server *s = (Server*)calloc(1, sizeof(*s));
+    ThreadPool *pool = pool_create(threads < 1 ? 1 : threads, (size_t)16 << 20);
+    if (!s || !pool){
+        free(s); pool_destroy(pool);
+        close(lfd); unlink(sock_path);
+        return 0;
+    }
+    s->book = book;
+    s->opt = *opt;
+    s->pool = pool;
+    pthread_mutex_init(&s->mu, NULL);
+    pthread_cond_init(&s->closed, NULL);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    serve_stop = 0;
+    while (!serve_stop){
+        struct pollfd pfd = { lfd, POLLIN, 0 };
+        if (poll(&pfd, 1, 250) > 0 && (pfd.revents & POLLIN)) serve_accept(s, lfd);
+    }
+    close(lfd);
+    unlink(sock_path);
+
+    /* let every connection finish the request it is on, then hang up */
+    pthread_mutex_lock(&s->mu);
+    for (Conn *c = s->conns; c; c = c->next) shutdown(c->fd, SHUT_RD);
+    while (s->nconns) pthread_cond_wait(&s->closed, &s->mu);
+    pthread_mutex_unlock(&s->mu);
+
+    pool_destroy(pool);
+    pthread_mutex_destroy(&s->mu);
+    pthread_cond_destroy(&s->closed);
+    free(s);
+    return 1;
+}
@@ -0,0 +1,23 @@
+#include "stream.h"
+
+static uint32_t mem_read(FxSource *s, float **dst, uint32_t count){
+    MemSource *m = (MemSource*)s;
+    uint32_t left = s->length - m->pos;
+    if (count > left) count = left;
+    for (uint16_t c=0;c<s->nch;c++){
+        if (dst[c] != m->x[c] + m->pos)
+            memcpy(dst[c], m->x[c] + m->pos, sizeof(float)*count);
+    }
+    m->pos += count;
+    return count;
+}
+static void mem_rewind(FxSource *s){ ((MemSource*)s)->pos = 0; }
+
+void mem_source_init(MemSource *m, float *const *x, uint32_t n, uint16_t nch){
+    m->base.read = mem_read;
+    m->base.rewind = mem_rewind;
+    m->base.length = n;
+    m->base.nch = nch;
+    m->x = x;
+    m->pos = 0;
+}
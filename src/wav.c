@@ -1,4 +1,11 @@
 #include "wav.h"
+#include "simd.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 static int read_u32le(FILE *f, uint32_t *v) {
     uint8_t b[4]; if (fread(b,1,4,f)!=4) return 0;
@@ -10,25 +17,78 @@ static int read_u16le(FILE *f, uint16_t *v) {
     *v = (uint16_t)b[0] | ((uint16_t)b[1]<<8);
     return 1;
 }
-static void write_u32le(FILE *f, uint32_t v){
-    uint8_t b[4]={v&0xFF,(v>>8)&0xFF,(v>>16)&0xFF,(v>>24)&0xFF}; fwrite(b,1,4,f);
+static uint8_t* put_u32le(uint8_t *b, uint32_t v){
+    b[0]=v&0xFF; b[1]=(v>>8)&0xFF; b[2]=(v>>16)&0xFF; b[3]=(v>>24)&0xFF; return b+4;
 }
-static void write_u16le(FILE *f, uint16_t v){
-    uint8_t b[2]={v&0xFF,(v>>8)&0xFF}; fwrite(b,1,2,f);
+static uint8_t* put_u16le(uint8_t *b, uint16_t v){
+    b[0]=v&0xFF; b[1]=(v>>8)&0xFF; return b+2;
 }
 
-int read_wav_header(FILE *f, WavInfo *info){
+static int read_u64le(FILE *f, uint64_t *v) {
+    uint32_t lo, hi;
+    if (!read_u32le(f,&lo) || !read_u32le(f,&hi)) return 0;
+    *v = (uint64_t)lo | ((uint64_t)hi << 32);
+    return 1;
+}
+static uint8_t* put_u64le(uint8_t *b, uint64_t v){
+    return put_u32le(put_u32le(b, (uint32_t)v), (uint32_t)(v >> 32));
+}
+
+uint32_t wav_format_bytes(WavFormat fmt){
+    switch (fmt){
+        case WAV_PCM16:   return 2;
+        case WAV_PCM24:   return 3;
+        case WAV_PCM32:
+        case WAV_FLOAT32: return 4;
+    }
+    return 2;
+}
+
+static int resolve_format(WavInfo *info){
+    uint16_t tag = info->audio_format, bits = info->bits_per_sample;
+    if (tag == 1 && bits == 16) info->format = WAV_PCM16;
+    else if (tag == 1 && bits == 24) info->format = WAV_PCM24;
+    else if (tag == 1 && bits == 32) info->format = WAV_PCM32;
+    else if (tag == 3 && bits == 32) info->format = WAV_FLOAT32;
+    else return 0;
+    return info->num_channels && info->block_align == info->num_channels * bits / 8;
+}
+
+static int skip_bytes(FILE *f, uint64_t n){
+    uint8_t buf[256];
+    while (n){
+        size_t k = n < sizeof(buf) ? (size_t)n : sizeof(buf);
+        if (fread(buf,1,k,f) != k) return 0;
+        n -= k;
+    }
+    return 1;
+}
+
+/* on a pipe chunks are skipped by reading them, and parsing stops at the
+   data chunk, whose size may be a placeholder */
+static int parse_header(FILE *f, WavInfo *info, const uint8_t *magic, int pipe){
     memset(info,0,sizeof(*info));
-    uint8_t riff[4]; if (fread(riff,1,4,f)!=4 || memcmp(riff,"RIFF",4)!=0) return 0;
+    uint8_t riff[4];
+    if (magic) memcpy(riff, magic, 4);
+    else if (fread(riff,1,4,f)!=4) return 0;
+    if (memcmp(riff,"RF64",4)==0) info->rf64 = 1;
+    else if (memcmp(riff,"RIFF",4)!=0) return 0;
     uint32_t riff_size; if (!read_u32le(f,&riff_size)) return 0;
     uint8_t wave[4]; if (fread(wave,1,4,f)!=4 || memcmp(wave,"WAVE",4)!=0) return 0;
 
+    uint64_t ds64_data = 0;
     int fmt_found=0, data_found=0;
     while (!fmt_found || !data_found){
         uint8_t id[4]; if (fread(id,1,4,f)!=4) return 0;
         uint32_t sz; if (!read_u32le(f,&sz)) return 0;
-        long chunk_start = ftell(f);
-        if (memcmp(id,"fmt ",4)==0){
+        uint64_t len = sz;
+        long chunk_start = pipe ? 0 : ftell(f);
+        uint64_t used = 0;
+        if (memcmp(id,"ds64",4)==0 && info->rf64){
+            uint64_t riff64;
+            if (!read_u64le(f,&riff64) || !read_u64le(f,&ds64_data)) return 0;
+            used = 16;
+        } else if (memcmp(id,"fmt ",4)==0){
             fmt_found=1;
             if (!read_u16le(f,&info->audio_format)) return 0;
             if (!read_u16le(f,&info->num_channels)) return 0;
@@ -36,65 +96,667 @@ int read_wav_header(FILE *f, WavInfo *info){
             if (!read_u32le(f,&info->byte_rate)) return 0;
             if (!read_u16le(f,&info->block_align)) return 0;
             if (!read_u16le(f,&info->bits_per_sample)) return 0;
-            fseek(f, chunk_start + sz, SEEK_SET);
+            used = 16;
+            if (info->audio_format == 0xFFFE && sz >= 40){
+                /* WAVE_FORMAT_EXTENSIBLE: the real tag leads the SubFormat GUID */
+                uint16_t cb, valid; uint32_t mask;
+                if (!read_u16le(f,&cb) || !read_u16le(f,&valid) || !read_u32le(f,&mask)) return 0;
+                if (!read_u16le(f,&info->audio_format)) return 0;
+                used += 10;
+            }
         } else if (memcmp(id,"data",4)==0){
             data_found=1;
-            info->data_size = sz;
-            info->data_offset = ftell(f);
-            fseek(f, sz, SEEK_CUR);
-        } else {
-            fseek(f, sz, SEEK_CUR);
+            if (info->rf64 && sz == 0xFFFFFFFFu) len = ds64_data;
+            info->data_size = len;
+            info->data_offset = chunk_start;
+            if (pipe){
+                if (!fmt_found) return 0;
+                break;
+            }
         }
-        if (sz & 1) fseek(f, 1, SEEK_CUR);
+        if (pipe){
+            if (used > len || !skip_bytes(f, len - used + (len & 1))) return 0;
+            continue;
+        }
+        if (fseek(f, chunk_start + (long)len + (long)(len & 1), SEEK_SET) != 0) break;
         if (feof(f)) break;
     }
     if (!fmt_found || !data_found) return 0;
-    if (info->audio_format != 1 || info->bits_per_sample != 16) return 0;
-    return 1;
+    return resolve_format(info);
+}
+
+int read_wav_header(FILE *f, WavInfo *info){
+    return parse_header(f, info, NULL, 0);
+}
+
+int read_wav_header_pipe(FILE *f, const uint8_t magic[4], WavInfo *info){
+    return parse_header(f, info, magic, 1);
+}
+
+/* RIFF header, or RF64 with a ds64 chunk when the sizes do not fit in 32
+   bits. Float data gets the 18-byte fmt chunk and a fact chunk. Returns the
+   header length; 16-bit PCM below 4 GiB is the classic 44-byte layout. */
+#define WAV_HEADER_MAX 96
+
+static size_t write_header(uint8_t *h, uint32_t nframes, uint16_t channels, uint32_t sample_rate,
+                           WavFormat fmt){
+    uint32_t bps = wav_format_bytes(fmt);
+    uint64_t data_bytes = (uint64_t)nframes * channels * bps;
+    int is_float = fmt == WAV_FLOAT32;
+    size_t fmt_len = is_float ? 18 : 16;
+    size_t len = 12 + 8 + fmt_len + (is_float ? 12 : 0) + 8;
+    int rf64 = data_bytes + len + 36 > 0xFFFFFFFFull;
+    if (rf64) len += 36;
+    uint64_t riff_size = len - 8 + data_bytes;
+    uint8_t *p = h;
+
+    memcpy(p, rf64 ? "RF64" : "RIFF", 4); p = put_u32le(p+4, rf64 ? 0xFFFFFFFFu : (uint32_t)riff_size);
+    memcpy(p,"WAVE",4); p += 4;
+    if (rf64){
+        memcpy(p,"ds64",4); p = put_u32le(p+4, 28);
+        p = put_u64le(p, riff_size);
+        p = put_u64le(p, data_bytes);
+        p = put_u64le(p, nframes);
+        p = put_u32le(p, 0);
+    }
+
+    memcpy(p,"fmt ",4); p = put_u32le(p+4, (uint32_t)fmt_len);
+    p = put_u16le(p, is_float ? 3 : 1); // PCM or IEEE float
+    p = put_u16le(p,channels);
+    p = put_u32le(p,sample_rate);
+    p = put_u32le(p,sample_rate * channels * bps);
+    p = put_u16le(p,(uint16_t)(channels * bps));
+    p = put_u16le(p,(uint16_t)(bps * 8));
+    if (is_float){
+        p = put_u16le(p,0);
+        memcpy(p,"fact",4); p = put_u32le(p+4, 4);
+        p = put_u32le(p, rf64 ? 0xFFFFFFFFu : nframes);
+    }
+
+    memcpy(p,"data",4); put_u32le(p+4, rf64 ? 0xFFFFFFFFu : (uint32_t)data_bytes);
+    return len;
 }
 
 int write_wav_file(const char *path, const float *interleaved, uint32_t nframes,
                    uint16_t channels, uint32_t sample_rate)
 {
-    FILE *f = fopen(path, "wb"); if (!f) return 0;
-    uint32_t data_bytes = nframes * channels * 2;
-
-    fwrite("RIFF",1,4,f);
-    write_u32le(f, 36 + data_bytes);
-    fwrite("WAVE",1,4,f);
-
-    fwrite("fmt ",1,4,f); write_u32le(f,16);
-    write_u16le(f,1); // PCM
-    write_u16le(f,channels);
-    write_u32le(f,sample_rate);
-    write_u32le(f,sample_rate * channels * 2);
-    write_u16le(f,channels * 2);
-    write_u16le(f,16);
-
-    fwrite("data",1,4,f); write_u32le(f,data_bytes);
-
-    for (uint32_t i=0;i<nframes*channels;i++){
-        float s = interleaved[i];
-        if (s>1.0f) s=1.0f; else if (s<-1.0f) s=-1.0f;
-        int16_t v = (int16_t)lrintf(s * 32767.0f);
-        uint8_t b[2] = { (uint8_t)(v & 0xFF), (uint8_t)((v>>8)&0xFF) };
-        fwrite(b,1,2,f);
-    }
-    fclose(f);
+    WavWriter w;
+    if (!wav_writer_open(&w, path, nframes, channels, sample_rate, WAV_PCM16, 4096)) return 0;
+    int ok = wav_writer_write_interleaved(&w, interleaved, nframes);
+    return wav_writer_close(&w) && ok;
+}
+
+static inline float s16_to_f(const uint8_t *b){
+    int16_t v = (int16_t)((uint16_t)b[0] | ((uint16_t)b[1] << 8));
+    return (float)v / 32768.0f;
+}
+
+#if SIMD_VEC && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define PCM_VEC 1
+/* adding 0x4B400000 to the bits of an int in (-2^22, 2^22) gives the float
+   1.5*2^23 + i exactly; scaling by 2^-15 matches the scalar division */
+static inline v4sf s32_to_f(v4si i){
+    const v4si bias = {0x4B400000,0x4B400000,0x4B400000,0x4B400000};
+    const v4sf magic = {12582912.0f,12582912.0f,12582912.0f,12582912.0f};
+    return ((v4sf)(i + bias) - magic) * (1.0f/32768.0f);
+}
+#else
+#define PCM_VEC 0
+#endif
+
+static void pcm16_mono(float *dst, const uint8_t *src, uint32_t n){
+    uint32_t i = 0;
+#if PCM_VEC
+    /* 8 samples per load: even ones in the low halves of the words, odd high */
+    for (; i+8<=n; i+=8){
+        v4si w; memcpy(&w, src + (size_t)i*2, 16);
+        v4sf e = s32_to_f((w << 16) >> 16), o = s32_to_f(w >> 16);
+        float *d = dst + i;
+        d[0]=e[0]; d[1]=o[0]; d[2]=e[1]; d[3]=o[1];
+        d[4]=e[2]; d[5]=o[2]; d[6]=e[3]; d[7]=o[3];
+    }
+#endif
+    for (; i<n; i++) dst[i] = s16_to_f(src + (size_t)i*2);
+}
+
+/* one stereo frame per 32-bit word: left in the low half, right high */
+static void pcm16_stereo(float *l, float *r, const uint8_t *src, uint32_t n){
+    uint32_t i = 0;
+#if PCM_VEC
+    for (; i+4<=n; i+=4){
+        v4si w; memcpy(&w, src + (size_t)i*4, 16);
+        if (l){ v4sf v = s32_to_f((w << 16) >> 16); memcpy(l+i, &v, 16); }
+        if (r){ v4sf v = s32_to_f(w >> 16); memcpy(r+i, &v, 16); }
+    }
+#endif
+    for (; i<n; i++){
+        if (l) l[i] = s16_to_f(src + (size_t)i*4);
+        if (r) r[i] = s16_to_f(src + (size_t)i*4 + 2);
+    }
+}
+
+/* one sample of any format at b */
+static inline float decode_sample(const uint8_t *b, WavFormat fmt){
+    switch (fmt){
+        case WAV_PCM16: return s16_to_f(b);
+        case WAV_PCM24: {
+            int32_t v = (int32_t)(((uint32_t)b[0] << 8) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 24)) >> 8;
+            return (float)v / 8388608.0f;
+        }
+        case WAV_PCM32: {
+            int32_t v = (int32_t)((uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24));
+            return (float)v / 2147483648.0f;
+        }
+        case WAV_FLOAT32: {
+            uint32_t u = (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+            float v; memcpy(&v, &u, 4);
+            return v;
+        }
+    }
+    return 0.0f;
+}
+
+#define WAV_TILE 4096   /* interleaved samples converted per step */
+
+#if SIMD_VEC
+static inline void transpose4(v4sf *a, v4sf *b, v4sf *c, v4sf *d){
+    v4sf t0 = SIMD_SHUF(*a, *b, 0, 4, 1, 5), t1 = SIMD_SHUF(*a, *b, 2, 6, 3, 7);
+    v4sf t2 = SIMD_SHUF(*c, *d, 0, 4, 1, 5), t3 = SIMD_SHUF(*c, *d, 2, 6, 3, 7);
+    *a = SIMD_SHUF(t0, t2, 0, 1, 4, 5); *b = SIMD_SHUF(t0, t2, 2, 3, 6, 7);
+    *c = SIMD_SHUF(t1, t3, 0, 1, 4, 5); *d = SIMD_SHUF(t1, t3, 2, 3, 6, 7);
+}
+#endif
+
+/* nc channels of n frames, `stride` floats apart, into planes. Four frames
+   of four channels are one 4x4 transpose; past four channels the last
+   group overlaps the one before instead of leaving a scalar tail. */
+static void deinterleave(float *const *dst, const float *in, size_t stride, uint16_t nc, uint32_t n){
+    uint32_t i = 0;
+#if SIMD_VEC
+    if (nc >= 4){
+        for (; i+4<=n; i+=4){
+            const float *p = in + (size_t)i*stride;
+            for (uint16_t c=0; c<nc; c+=4){
+                if (c + 4 > nc) c = nc - 4;
+                v4sf r0, r1, r2, r3;
+                memcpy(&r0, p + c, 16); memcpy(&r1, p + stride + c, 16);
+                memcpy(&r2, p + 2*stride + c, 16); memcpy(&r3, p + 3*stride + c, 16);
+                transpose4(&r0, &r1, &r2, &r3);
+                memcpy(dst[c]+i, &r0, 16); memcpy(dst[c+1]+i, &r1, 16);
+                memcpy(dst[c+2]+i, &r2, 16); memcpy(dst[c+3]+i, &r3, 16);
+            }
+        }
+    } else if (nc == 2 && stride == 2){
+        for (; i+4<=n; i+=4){
+            v4sf a, b;
+            memcpy(&a, in + 2*i, 16); memcpy(&b, in + 2*i + 4, 16);
+            v4sf l = SIMD_SHUF(a, b, 0, 2, 4, 6), r = SIMD_SHUF(a, b, 1, 3, 5, 7);
+            memcpy(dst[0]+i, &l, 16); memcpy(dst[1]+i, &r, 16);
+        }
+    }
+#endif
+    if (nc == 1 && stride == 1){ memcpy(dst[0]+i, in+i, sizeof(float)*(n-i)); return; }
+    for (; i<n; i++)
+        for (uint16_t c=0; c<nc; c++) dst[c][i] = in[(size_t)i*stride + c];
+}
+
+/* the inverse, each channel times g[c] (unity when g is NULL) */
+static void interleave(float *out, size_t stride, float *const *src, const float *g, uint16_t nc,
+                       uint32_t n){
+    uint32_t i = 0;
+#if SIMD_VEC
+    if (nc >= 4){
+        for (; i+4<=n; i+=4){
+            float *p = out + (size_t)i*stride;
+            for (uint16_t c=0; c<nc; c+=4){
+                if (c + 4 > nc) c = nc - 4;
+                v4sf r0, r1, r2, r3;
+                memcpy(&r0, src[c]+i, 16); memcpy(&r1, src[c+1]+i, 16);
+                memcpy(&r2, src[c+2]+i, 16); memcpy(&r3, src[c+3]+i, 16);
+                if (g){ r0 *= g[c]; r1 *= g[c+1]; r2 *= g[c+2]; r3 *= g[c+3]; }
+                transpose4(&r0, &r1, &r2, &r3);
+                memcpy(p + c, &r0, 16); memcpy(p + stride + c, &r1, 16);
+                memcpy(p + 2*stride + c, &r2, 16); memcpy(p + 3*stride + c, &r3, 16);
+            }
+        }
+    } else if (nc == 2 && stride == 2){
+        for (; i+4<=n; i+=4){
+            v4sf l, r;
+            memcpy(&l, src[0]+i, 16); memcpy(&r, src[1]+i, 16);
+            if (g){ l *= g[0]; r *= g[1]; }
+            v4sf a = SIMD_SHUF(l, r, 0, 4, 1, 5), b = SIMD_SHUF(l, r, 2, 6, 3, 7);
+            memcpy(out + 2*i, &a, 16); memcpy(out + 2*i + 4, &b, 16);
+        }
+    }
+#endif
+    for (; i<n; i++)
+        for (uint16_t c=0; c<nc; c++) out[(size_t)i*stride + c] = g ? src[c][i] * g[c] : src[c][i];
+}
+
+void wav_decode_channels(float *const *dst, const uint8_t *src, WavFormat fmt, uint16_t ch,
+                         uint16_t c0, uint16_t nc, uint32_t n){
+    if (fmt == WAV_PCM16 && ch == 1){ pcm16_mono(dst[0], src, n); return; }
+    if (fmt == WAV_PCM16 && ch == 2){
+        pcm16_stereo(c0 == 0 ? dst[0] : NULL, c0 + nc == 2 ? dst[nc-1] : NULL, src, n);
+        return;
+    }
+    size_t bps = wav_format_bytes(fmt), fb = bps * ch;
+    if (fmt == WAV_PCM16 && ch <= WAV_TILE / 4){
+        /* whole frames to float in order, then split into planes from L1 */
+        float tmp[WAV_TILE];
+        uint32_t tile = WAV_TILE / ch;
+        for (uint32_t off=0; off<n; off+=tile){
+            uint32_t cnt = n - off < tile ? n - off : tile;
+            pcm16_mono(tmp, src + (size_t)off*fb, cnt * ch);
+            float *d[nc];
+            for (uint16_t c=0;c<nc;c++) d[c] = dst[c] + off;
+            deinterleave(d, tmp + c0, ch, nc, cnt);
+        }
+        return;
+    }
+    for (uint16_t c=0;c<nc;c++){
+        const uint8_t *b = src + (c0 + c)*bps;
+        float *d = dst[c];
+        for (uint32_t i=0;i<n;i++) d[i] = decode_sample(b + (size_t)i*fb, fmt);
+    }
+}
+
+void wav_decode(float *const *dst, const uint8_t *src, WavFormat fmt, uint16_t ch, uint32_t n){
+    wav_decode_channels(dst, src, fmt, ch, 0, ch, n);
+}
+
+void wav_decode_channel(float *dst, const uint8_t *src, WavFormat fmt, uint16_t ch, uint16_t c,
+                        uint32_t n){
+    if (fmt == WAV_PCM16 && ch == 1){ pcm16_mono(dst, src, n); return; }
+    if (fmt == WAV_PCM16 && ch == 2){ pcm16_stereo(c == 0 ? dst : NULL, c == 1 ? dst : NULL, src, n); return; }
+    size_t bps = wav_format_bytes(fmt);
+    for (uint32_t i=0;i<n;i++) dst[i] = decode_sample(src + ((size_t)i*ch + c)*bps, fmt);
+}
+
+#define WAV_RELEASE_BYTES (1u<<20)
+
+/* drops the mapped pages below `upto` once a megabyte of them has piled up,
+   so a pass over a long file keeps only a window of it resident */
+static void release_pages(uint8_t *base, size_t *done, size_t upto){
+    size_t pg = (size_t)sysconf(_SC_PAGESIZE);
+    size_t end = upto & ~(pg - 1);
+    if (end < *done + WAV_RELEASE_BYTES) return;
+    madvise(base + *done, end - *done, MADV_DONTNEED);
+    *done = end;
+}
+
+static size_t frame_bytes(const WavInfo *info){
+    return (size_t)info->num_channels * wav_format_bytes(info->format);
+}
+
+static uint32_t clamp_frames(uint64_t n){
+    return n > UINT32_MAX ? UINT32_MAX : (uint32_t)n;
+}
+
+/* maps the file up to the end of the data chunk, or what exists of it */
+static int map_data(int fd, const WavInfo *info, void **base, size_t *len, uint32_t *nframes){
+    struct stat st;
+    size_t fb = frame_bytes(info);
+    *base = NULL; *len = 0; *nframes = 0;
+    if (!fb || fstat(fd, &st) != 0 || st.st_size < info->data_offset) return 0;
+    size_t avail = (size_t)st.st_size - (size_t)info->data_offset;
+    if (avail > info->data_size) avail = info->data_size;
+    *nframes = clamp_frames(avail / fb);
+    *len = (size_t)info->data_offset + avail;
+    if (!*len) return 0;
+    void *m = mmap(NULL, *len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (m == MAP_FAILED){ *len = 0; return 0; }
+    *base = m;
+    return 1;
+}
+
+int wav_map_open(WavMap *m, int fd, const WavInfo *info){
+    memset(m,0,sizeof(*m));
+    if (map_data(fd, info, &m->base, &m->len, &m->nframes)){
+        m->data = (const uint8_t*)m->base + info->data_offset;
+        return 1;
+    }
+    /* not mappable: read the frames that are there */
+    size_t want = (size_t)m->nframes * frame_bytes(info), got = 0;
+    m->copy = (uint8_t*)malloc(want ? want : 1);
+    if (!m->copy) return 0;
+    while (got < want){
+        ssize_t r = pread(fd, m->copy + got, want - got, (off_t)info->data_offset + (off_t)got);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        got += (size_t)r;
+    }
+    m->nframes = (uint32_t)(got / frame_bytes(info));
+    m->data = m->copy;
+    return 1;
+}
+
+void wav_map_close(WavMap *m){
+    if (m->base) munmap(m->base, m->len);
+    free(m->copy);
+    memset(m,0,sizeof(*m));
+}
+
+static uint32_t wav_source_read(FxSource *s, float **dst, uint32_t count){
+    WavSource *w = (WavSource*)s;
+    uint16_t ch = s->nch;
+    uint32_t left = s->length - w->pos;
+    if (count > left) count = left;
+    if (!count) return 0;
+    size_t fb = (size_t)ch * wav_format_bytes(w->format);
+
+    if (w->data){
+        if (w->pos >= w->avail) return 0;
+        if (count > w->avail - w->pos) count = w->avail - w->pos;
+        wav_decode(dst, w->data + (size_t)w->pos * fb, w->format, ch, count);
+        w->pos += count;
+        release_pages((uint8_t*)w->map, &w->released, (size_t)w->data_offset + (size_t)w->pos * fb);
+        return count;
+    }
+    if (count > w->cap) count = w->cap;
+    size_t want = (size_t)count * fb, got = 0;
+    off_t off = (off_t)w->data_offset + (off_t)w->pos * (off_t)fb;
+    while (got < want){
+        ssize_t r = pread(w->fd, w->pcm + got, want - got, off + (off_t)got);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        got += (size_t)r;
+    }
+    count = (uint32_t)(got / fb);
+    wav_decode(dst, w->pcm, w->format, ch, count);
+    w->pos += count;
+    return count;
+}
+static void wav_source_rewind(FxSource *s){
+    WavSource *w = (WavSource*)s;
+    w->pos = 0;
+    w->released = 0;
+}
+
+int wav_source_open(WavSource *w, int fd, const WavInfo *info, uint32_t block){
+    memset(w,0,sizeof(*w));
+    if (!info->num_channels || !block) return 0;
+    w->base.read = wav_source_read;
+    w->base.rewind = wav_source_rewind;
+    w->base.nch = info->num_channels;
+    w->base.length = clamp_frames(info->data_size / frame_bytes(info));
+    w->format = info->format;
+    w->fd = fd;
+    w->data_offset = info->data_offset;
+    w->cap = block;
+    if (map_data(fd, info, &w->map, &w->map_len, &w->avail)){
+        madvise(w->map, w->map_len, MADV_SEQUENTIAL);
+        w->data = (const uint8_t*)w->map + info->data_offset;
+        return 1;
+    }
+    w->pcm = (uint8_t*)malloc((size_t)block * frame_bytes(info));
+    return w->pcm != NULL;
+}
+void wav_source_close(WavSource *w){
+    if (w->map) munmap(w->map, w->map_len);
+    free(w->pcm);
+    w->map = NULL; w->data = NULL; w->pcm = NULL;
+}
+
+static inline void put_s16(uint8_t *b, float s){
+    if (s>1.0f) s=1.0f; else if (s<-1.0f) s=-1.0f;
+    int16_t v = (int16_t)lrintf(s * 32767.0f);
+    b[0] = (uint8_t)(v & 0xFF); b[1] = (uint8_t)((v>>8)&0xFF);
+}
+
+#if SIMD_VEC
+/* put_s16() on 4 lanes. Adding 1.5*2^23 rounds to nearest even like
+   lrintf() in the default mode and leaves the integer in the low mantissa
+   bits; NaN maps to 0 as lrintf's out-of-range result does on x86-64. */
+static inline v4si quant_s16(v4sf s){
+    const v4sf one = {1.0f,1.0f,1.0f,1.0f}, mone = -one;
+    const v4sf magic = {12582912.0f,12582912.0f,12582912.0f,12582912.0f};
+    v4si hi = s > one, lo = s < mone, nan = s != s;
+    s = (v4sf)(((v4si)one & hi) | ((v4si)mone & lo) | ((v4si)s & ~(hi | lo)));
+    v4sf y = s * 32767.0f;
+    return ((v4si)(y + magic) - (v4si)magic) & ~nan;
+}
+#endif
+
+/* n samples from x, times g, to little-endian int16 at dst, `stride`
+   bytes apart */
+static void quant_block(uint8_t *dst, size_t stride, const float *x, uint32_t n, float g){
+    uint32_t i = 0;
+#if SIMD_VEC
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if (stride == 2){
+        for (; i+4<=n; i+=4){
+            v4sf s; memcpy(&s, x+i, 16);
+            v4hi h = __builtin_convertvector(quant_s16(s * g), v4hi);
+            memcpy(dst + (size_t)i*2, &h, 8);
+        }
+    }
+#endif
+    for (; i+4<=n; i+=4){
+        v4sf s; memcpy(&s, x+i, 16);
+        v4si q = quant_s16(s * g);
+        for (int k=0;k<4;k++){
+            uint8_t *b = dst + (size_t)(i+k)*stride;
+            b[0] = (uint8_t)(q[k] & 0xFF); b[1] = (uint8_t)((q[k]>>8) & 0xFF);
+        }
+    }
+#endif
+    for (; i<n; i++) put_s16(dst + (size_t)i*stride, x[i] * g);
+}
+
+static void quant_planar(uint8_t *dst, float *const *x, const float *g, uint16_t ch, uint32_t n){
+#if SIMD_VEC && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if (ch == 2){
+        /* one 32-bit word per stereo frame: L in the low half, R in the high */
+        uint32_t i = 0;
+        for (; i+4<=n; i+=4){
+            v4sf l, r;
+            memcpy(&l, x[0]+i, 16); memcpy(&r, x[1]+i, 16);
+            v4su w = ((v4su)quant_s16(l * g[0]) & 0xFFFFu) | ((v4su)quant_s16(r * g[1]) << 16);
+            memcpy(dst + (size_t)i*4, &w, 16);
+        }
+        for (; i<n; i++){
+            put_s16(dst + (size_t)i*4, x[0][i] * g[0]);
+            put_s16(dst + (size_t)i*4 + 2, x[1][i] * g[1]);
+        }
+        return;
+    }
+#endif
+    if (ch > 2 && ch <= WAV_TILE / 4){
+        float tmp[WAV_TILE];
+        uint32_t tile = WAV_TILE / ch;
+        for (uint32_t off=0; off<n; off+=tile){
+            uint32_t cnt = n - off < tile ? n - off : tile;
+            float *s[ch];
+            for (uint16_t c=0;c<ch;c++) s[c] = x[c] + off;
+            interleave(tmp, ch, s, g, ch, cnt);
+            quant_block(dst + (size_t)off*ch*2, 2, tmp, cnt*ch, 1.0f);
+        }
+        return;
+    }
+    for (uint16_t c=0;c<ch;c++) quant_block(dst + 2*c, (size_t)ch*2, x[c], n, g[c]);
+}
+
+/* one sample in any format; float samples are stored as they are */
+static inline void put_sample(uint8_t *b, float s, WavFormat fmt){
+    if (fmt == WAV_PCM16){ put_s16(b, s); return; }
+    if (fmt == WAV_FLOAT32){
+        uint32_t u; memcpy(&u, &s, 4);
+        put_u32le(b, u);
+        return;
+    }
+    if (s>1.0f) s=1.0f; else if (s<-1.0f) s=-1.0f;
+    if (fmt == WAV_PCM24){
+        int32_t v = (int32_t)lrint((double)s * 8388607.0);
+        b[0] = (uint8_t)(v & 0xFF); b[1] = (uint8_t)((v>>8)&0xFF); b[2] = (uint8_t)((v>>16)&0xFF);
+    } else {
+        put_u32le(b, (uint32_t)(int32_t)lrint((double)s * 2147483647.0));
+    }
+}
+
+static void encode_planar(uint8_t *dst, float *const *x, const float *g, uint16_t ch, WavFormat fmt,
+                          uint32_t n){
+    if (fmt == WAV_PCM16){ quant_planar(dst, x, g, ch, n); return; }
+    size_t bps = wav_format_bytes(fmt), fb = bps * ch;
+    for (uint16_t c=0;c<ch;c++){
+        uint8_t *b = dst + c*bps;
+        for (uint32_t i=0;i<n;i++) put_sample(b + (size_t)i*fb, x[c][i] * g[c], fmt);
+    }
+}
+
+void wav_encode(uint8_t *dst, float *const *src, WavFormat fmt, uint16_t ch, uint32_t n){
+    float unity[ch];
+    for (uint16_t c=0;c<ch;c++) unity[c] = 1.0f;
+    encode_planar(dst, src, unity, ch, fmt, n);
+}
+
+static int write_all(int fd, const uint8_t *b, size_t len){
+    while (len){
+        ssize_t r = write(fd, b, len);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return 0;
+        b += r; len -= (size_t)r;
+    }
     return 1;
 }
 
-void split_interleaved_to_planar(const float *in, float *L, float *R,
-                                 uint32_t nframes, uint16_t ch){
-    if (ch==1){ memcpy(L,in,sizeof(float)*nframes); }
-    else {
-        for (uint32_t i=0;i<nframes;i++){ L[i]=in[2*i]; R[i]=in[2*i+1]; }
+static int writer_flush(WavWriter *w){
+    if (w->fill && !w->err && !write_all(w->fd, w->bytes, w->fill)) w->err = 1;
+    w->fill = 0;
+    return !w->err;
+}
+
+static size_t writer_frame_bytes(const WavWriter *w){
+    return (size_t)w->channels * wav_format_bytes(w->format);
+}
+
+int wav_writer_open(WavWriter *w, const char *path, uint32_t nframes, uint16_t channels,
+                    uint32_t sample_rate, WavFormat fmt, uint32_t block){
+    memset(w,0,sizeof(*w));
+    w->fd = -1;
+    if (!channels) return 0;
+    w->channels = channels;
+    w->format = fmt;
+    w->nframes = nframes;
+    uint8_t h[WAV_HEADER_MAX];
+    w->hdr_len = write_header(h, nframes, channels, sample_rate, fmt);
+
+    w->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (w->fd < 0) return 0;
+
+    size_t total = w->hdr_len + (size_t)nframes * writer_frame_bytes(w);
+    int r = posix_fallocate(w->fd, 0, (off_t)total);
+    if (r == 0){
+        void *m = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_SHARED, w->fd, 0);
+        if (m != MAP_FAILED){
+            w->map = (uint8_t*)m;
+            w->map_len = total;
+            memcpy(w->map, h, w->hdr_len);
+            return 1;
+        }
+        if (ftruncate(w->fd, 0) != 0){ wav_writer_close(w); return 0; }
+    } else if (r == ENOSPC || r == EFBIG || r == EIO){
+        wav_writer_close(w);
+        return 0;
     }
+
+    /* not mappable: stage through a buffer of at least 64 KiB */
+    w->cap = (size_t)block * writer_frame_bytes(w);
+    if (w->cap < (1u<<16)) w->cap = 1u<<16;
+    w->bytes = (uint8_t*)malloc(w->cap);
+    if (!w->bytes){ wav_writer_close(w); return 0; }
+    memcpy(w->bytes, h, w->hdr_len);
+    w->fill = w->hdr_len;
+    return 1;
 }
-void join_planar_to_interleaved(float *out, const float *L, const float *R,
-                                uint32_t nframes, uint16_t ch){
-    if (ch==1){ memcpy(out,L,sizeof(float)*nframes); }
-    else {
-        for (uint32_t i=0;i<nframes;i++){ out[2*i]=L[i]; out[2*i+1]=R[i]; }
+
+/* room for the next `nframes`: a pointer into the map or the staging buffer */
+static uint8_t* writer_reserve(WavWriter *w, uint32_t *nframes){
+    size_t fb = writer_frame_bytes(w);
+    if (w->err || (uint64_t)w->done + *nframes > w->nframes){ w->err = 1; return NULL; }
+    if (w->map){
+        uint32_t step = (uint32_t)(WAV_RELEASE_BYTES / fb);
+        if (*nframes > step) *nframes = step;
+        return w->map + w->hdr_len + (size_t)w->done * fb;
     }
+    if (w->cap - w->fill < fb && !writer_flush(w)) return NULL;
+    size_t fit = (w->cap - w->fill) / fb;
+    if (*nframes > fit) *nframes = (uint32_t)fit;
+    return w->bytes + w->fill;
+}
+
+static void writer_commit(WavWriter *w, uint32_t nframes){
+    w->done += nframes;
+    if (w->map) release_pages(w->map, &w->released, w->hdr_len + (size_t)w->done * writer_frame_bytes(w));
+    else w->fill += (size_t)nframes * writer_frame_bytes(w);
+}
+
+int wav_writer_write(WavWriter *w, float *const *planar, uint32_t nframes){
+    return wav_writer_write_scaled(w, planar, NULL, nframes);
+}
+
+int wav_writer_write_scaled(WavWriter *w, float *const *planar, const float *gain, uint32_t nframes){
+    float unity[w->channels];
+    if (!gain){
+        for (uint16_t c=0;c<w->channels;c++) unity[c] = 1.0f;
+        gain = unity;
+    }
+    for (uint32_t off=0; off<nframes; ){
+        uint32_t cnt = nframes - off;
+        uint8_t *dst = writer_reserve(w, &cnt);
+        if (!dst) return 0;
+        float *src[w->channels];
+        for (uint16_t c=0;c<w->channels;c++) src[c] = planar[c] + off;
+        encode_planar(dst, src, gain, w->channels, w->format, cnt);
+        writer_commit(w, cnt);
+        off += cnt;
+    }
+    return !w->err;
+}
+
+int wav_writer_write_interleaved(WavWriter *w, const float *x, uint32_t nframes){
+    for (uint32_t off=0; off<nframes; ){
+        uint32_t cnt = nframes - off;
+        uint8_t *dst = writer_reserve(w, &cnt);
+        if (!dst) return 0;
+        const float *src = x + (size_t)off*w->channels;
+        if (w->format == WAV_PCM16) quant_block(dst, 2, src, cnt*w->channels, 1.0f);
+        else {
+            size_t bps = wav_format_bytes(w->format);
+            for (size_t i=0;i<(size_t)cnt*w->channels;i++) put_sample(dst + i*bps, src[i], w->format);
+        }
+        writer_commit(w, cnt);
+        off += cnt;
+    }
+    return !w->err;
+}
+
+int wav_writer_write_raw(WavWriter *w, const uint8_t *frames, uint32_t nframes){
+    size_t fb = writer_frame_bytes(w);
+    for (uint32_t off=0; off<nframes; ){
+        uint32_t cnt = nframes - off;
+        uint8_t *dst = writer_reserve(w, &cnt);
+        if (!dst) return 0;
+        memcpy(dst, frames + (size_t)off*fb, (size_t)cnt*fb);
+        writer_commit(w, cnt);
+        off += cnt;
+    }
+    return !w->err;
+}
+
+int wav_writer_close(WavWriter *w){
+    if (w->bytes) writer_flush(w);
+    int ok = !w->err;
+    if (w->map && munmap(w->map, w->map_len) != 0) ok = 0;
+    if (w->fd >= 0 && close(w->fd) != 0) ok = 0;
+    free(w->bytes);
+    w->fd = -1; w->map = NULL; w->bytes = NULL;
+    return ok;
+}
+
+void split_interleaved_to_planar(const float *in, float *const *dst, uint32_t nframes, uint16_t ch){
+    deinterleave(dst, in, ch, ch, nframes);
+}
+void join_planar_to_interleaved(float *out, float *const *src, uint32_t nframes, uint16_t ch){
+    interleave(out, ch, src, NULL, ch, nframes);
 }